@@ -0,0 +1,65 @@
+// Times whole frames drawing a large number of small decals spread over a few textures. Build it like any sample,
+// e.g. make release SRC=bench/decals.cpp && ./build/sample
+
+#include <chrono>
+#include <cstdio>
+
+#include <pixel/pixel.hpp>
+using namespace pixel;
+
+int main() {
+  const uint32_t decals   = 100000;
+  const uint32_t textures = 4;
+  const uint32_t warmup   = 3;
+  const uint32_t frames   = 20;
+
+  std::vector<Sprite> sprites;
+
+  uint32_t frame = 0;
+  auto     start = std::chrono::steady_clock::now();
+
+  Application app({
+      .size      = vu2d(1280, 720),
+      .scale     = 1,
+      .name      = "Decal benchmark",
+      .on_launch = fn([&](Application& app) {
+        sprites.reserve(textures);
+
+        for (uint32_t i = 0; i < textures; i++) {
+          Sprite& sprite = sprites.emplace_back(8, 8);
+
+          for (uint32_t y = 0; y < 8; y++) {
+            for (uint32_t x = 0; x < 8; x++) sprite.SetPixel(x, y, Pixel(64 * i, 8 * x, 8 * y, 200));
+          }
+
+          app.RegisterSprite(&sprite);
+        }
+
+        return pixel::ok;
+      }),
+      .on_update = fn([&](Application& app) {
+        if (frame == warmup) start = std::chrono::steady_clock::now();
+
+        if (frame == warmup + frames) {
+          auto   end = std::chrono::steady_clock::now();
+          double ms  = std::chrono::duration<double, std::milli>(end - start).count() / frames;
+
+          printf("%u decals  %8.3f ms/frame\n", decals, ms);
+          return pixel::quit;
+        }
+
+        srand(frame++);
+
+        for (uint32_t i = 0; i < decals; i++) {
+          vu2d pos(rand() % app.ScreenSize().x, rand() % app.ScreenSize().y);
+          app.DrawSprite(pos, &sprites[rand() % textures]);
+        }
+
+        return pixel::ok;
+      }),
+  });
+
+  app.Launch();
+
+  return 0;
+}
@@ -0,0 +1,233 @@
+// Sweeps every layer primitive over sizes, orientations, clipping cases and drawing modes on a headless application,
+// and prints the results as JSON so runs of different library versions can be diffed. Build it with make bench and
+// run ./build/bench > results.json. Decal text is only recorded, never rasterized, so its pixel metrics are null
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <pixel/pixel.hpp>
+using namespace pixel;
+
+namespace {
+  const uint32_t screen   = 1024;
+  const uint32_t variants = 16;
+  const double   min_time = 0.01;
+
+  // One benchmark case: a primitive drawn with one of a handful of precomputed geometries per call
+  struct bench_case {
+    std::string primitive;
+    std::string orientation;
+    std::string clipping;
+    uint32_t    size;
+
+    pixel::DrawingMode mode;
+    pixel::TextMode    text_mode;
+
+    std::function<void(Application&, const vu2d&, uint32_t, const Pixel&)> draw;
+
+    // Bounding box of one call, relative to its origin
+    vu2d extent;
+
+    // Whether the timed calls write the pixels counted for the case
+    bool rasterized = true;
+  };
+
+  const char* mode_name(pixel::DrawingMode mode) {
+    const char* names[] = {"NO_ALPHA", "FULL_ALPHA", "MASK"};
+    return names[(uint8_t)mode];
+  }
+
+  // Top left corner of variant v, fully inside the screen, straddling its bottom right edges or fully past them
+  vu2d place(const std::string& clipping, uint32_t size, uint32_t v) {
+    uint32_t spread = screen - size - 2;
+    uint32_t x      = 1 + (v * 7919) % spread;
+    uint32_t y      = 1 + (v * 104729) % spread;
+
+    if (clipping == "partial") return vu2d(screen - size / 2 - v % 4, screen - size / 2 - v % 3);
+    if (clipping == "outside") return vu2d(screen + 8 + v, y);
+
+    return vu2d(x, y);
+  }
+
+  std::vector<bench_case> make_cases() {
+    std::vector<bench_case> cases;
+
+    const uint32_t           sizes[]     = {4, 16, 64, 256};
+    const char*              clippings[] = {"inside", "partial", "outside"};
+    const pixel::DrawingMode modes[]     = {DrawingMode::NO_ALPHA, DrawingMode::FULL_ALPHA, DrawingMode::MASK};
+
+    // Line and triangle shapes as offsets in units of the case size, divided by 4
+    struct shape {
+      const char* name;
+      vi2d        a;
+      vi2d        b;
+    };
+
+    const shape lines[] = {
+        {"horizontal", vi2d(4, 0), vi2d(0, 0)},
+        {"vertical", vi2d(0, 4), vi2d(0, 0)},
+        {"diagonal", vi2d(4, 4), vi2d(0, 0)},
+        {"shallow", vi2d(4, 1), vi2d(0, 0)},
+        {"steep", vi2d(1, 4), vi2d(0, 0)},
+    };
+
+    const shape triangles[] = {
+        {"flat", vi2d(4, 0), vi2d(2, 4)},
+        {"general", vi2d(4, 1), vi2d(1, 4)},
+        {"sliver", vi2d(4, 3), vi2d(3, 4)},
+    };
+
+    auto offset = [](const vu2d& origin, const vi2d& unit, uint32_t size) {
+      return vu2d(origin.x + unit.x * size / 4, origin.y + unit.y * size / 4);
+    };
+
+    for (auto mode : modes) {
+      for (const char* clipping : clippings) {
+        auto add = [&](const std::string& primitive, const std::string& orientation, uint32_t size, auto draw) {
+          cases.push_back({primitive, orientation, clipping, size, mode, TextMode::DECAL, draw, vu2d(size, size)});
+        };
+
+        add("Draw", "-", 1, [](Application& app, const vu2d& o, uint32_t, const Pixel& c) { app.Draw(o, c); });
+
+        for (uint32_t size : sizes) {
+          for (const shape& line : lines) {
+            add("DrawLine", line.name, size, [=](Application& app, const vu2d& o, uint32_t s, const Pixel& c) {
+              app.DrawLine(o, offset(o, line.a, s), c);
+            });
+          }
+
+          for (const shape& tri : triangles) {
+            add("FillTriangle", tri.name, size, [=](Application& app, const vu2d& o, uint32_t s, const Pixel& c) {
+              app.FillTriangle(o, offset(o, tri.a, s), offset(o, tri.b, s), c);
+            });
+          }
+
+          add("DrawCircle", "-", size, [](Application& app, const vu2d& o, uint32_t s, const Pixel& c) {
+            app.DrawCircle(o + vu2d(s / 2, s / 2), s / 2, c);
+          });
+
+          add("FillCircle", "-", size, [](Application& app, const vu2d& o, uint32_t s, const Pixel& c) {
+            app.FillCircle(o + vu2d(s / 2, s / 2), s / 2, c);
+          });
+
+          add("FillRect", "-", size, [](Application& app, const vu2d& o, uint32_t s, const Pixel& c) {
+            app.FillRect(o, o + vu2d(s - 1, s - 1), c);
+          });
+        }
+
+        for (uint32_t size : {8u, 16u, 32u}) {
+          for (auto text_mode : {TextMode::DECAL, TextMode::LAYER}) {
+            add("DrawString", text_mode == TextMode::DECAL ? "decal" : "layer", size,
+                [](Application& app, const vu2d& o, uint32_t s, const Pixel& c) {
+                  app.DrawString(o, "The quick brown fox 0123456789", s, c);
+                });
+
+            cases.back().text_mode  = text_mode;
+            cases.back().extent     = vu2d(size * 30, size);
+            cases.back().rasterized = text_mode == TextMode::LAYER;
+          }
+        }
+      }
+    }
+
+    return cases;
+  }
+}
+
+int main() {
+  std::vector<bench_case> cases = make_cases();
+
+  // Translucent colour, so FULL_ALPHA really blends and MASK really rejects
+  const Pixel color(255, 128, 64, 160);
+
+  uint32_t index = 0;
+
+  printf("{\n  \"screen\": [%u, %u],\n  \"results\": [\n", screen, screen);
+
+  // One case per frame, so the decals recorded by decal text never pile up beyond a single case
+  Application app({
+      .size      = vu2d(screen, screen),
+      .name      = "Primitive benchmark",
+      .headless  = true,
+      .on_update = fn([&](Application& app) {
+        if (index == cases.size()) return pixel::quit;
+
+        bench_case& bench = cases[index];
+
+        auto draw = [&](uint32_t v, const Pixel& c) {
+          bench.draw(app, place(bench.clipping, bench.size, v), bench.size, c);
+        };
+
+        // Covered pixels are counted by drawing each variant opaque into its cleared bounding box
+        app.SetDrawingMode(DrawingMode::NO_ALPHA);
+        app.SetTextMode(TextMode::LAYER);
+
+        uint64_t pixels = 0;
+
+        for (uint32_t v = 0; v < variants && bench.rasterized; v++) {
+          vu2d min = place(bench.clipping, bench.size, v);
+          vu2d max = min + bench.extent;
+
+          if (min.x >= screen || min.y >= screen) continue;
+
+          max = vu2d(std::min(max.x, screen - 1), std::min(max.y, screen - 1));
+
+          app.FillRect(min, max, Pixel(0, 0, 0, 0));
+          draw(v, White);
+
+          for (uint32_t y = min.y; y <= max.y; y++) {
+            for (uint32_t x = min.x; x <= max.x; x++) pixels += app.Frame()[y * screen + x].n != 0;
+          }
+        }
+
+        app.SetDrawingMode(bench.mode);
+        app.SetTextMode(bench.text_mode);
+
+        uint64_t calls = 0;
+        auto     start = std::chrono::steady_clock::now();
+        double   elapsed;
+
+        do {
+          for (uint32_t v = 0; v < variants; v++) draw(v, color);
+
+          calls += variants;
+          elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed < min_time);
+
+        double per_call = (double)pixels / variants;
+        char   metrics[96] = "\"pixels_per_call\": null, \"pixels_per_second\": null";
+
+        if (bench.rasterized) {
+          snprintf(metrics,
+                   sizeof(metrics),
+                   "\"pixels_per_call\": %.1f, \"pixels_per_second\": %.0f",
+                   per_call,
+                   per_call * calls / elapsed);
+        }
+
+        printf("    {\"primitive\": \"%s\", \"orientation\": \"%s\", \"clipping\": \"%s\", \"size\": %u, "
+               "\"mode\": \"%s\", \"calls\": %llu, \"ns_per_call\": %.2f, %s}%s\n",
+               bench.primitive.c_str(),
+               bench.orientation.c_str(),
+               bench.clipping.c_str(),
+               bench.size,
+               mode_name(bench.mode),
+               (unsigned long long)calls,
+               elapsed * 1e9 / calls,
+               metrics,
+               ++index == cases.size() ? "" : ",");
+
+        return pixel::ok;
+      }),
+  });
+
+  app.Launch();
+
+  printf("  ]\n}\n");
+
+  return 0;
+}
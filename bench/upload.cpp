@@ -0,0 +1,41 @@
+// Times whole frames while the full framebuffer is redrawn every frame, so each one uploads the entire layer. Build it
+// like any sample, e.g. make release SRC=bench/upload.cpp && ./build/sample
+
+#include <chrono>
+#include <cstdio>
+
+#include <pixel/pixel.hpp>
+using namespace pixel;
+
+int main() {
+  const uint32_t warmup = 10;
+  const uint32_t frames = 200;
+
+  uint32_t frame = 0;
+  auto     start = std::chrono::steady_clock::now();
+
+  Application app({
+      .size      = vu2d(1920, 1080),
+      .name      = "Upload benchmark",
+      .vsync     = false,
+      .on_update = fn([&](Application& app) {
+        if (frame == warmup) start = std::chrono::steady_clock::now();
+
+        if (frame == warmup + frames) {
+          auto   end = std::chrono::steady_clock::now();
+          double ms  = std::chrono::duration<double, std::milli>(end - start).count() / frames;
+
+          printf("%ux%u  %8.3f ms/frame\n", app.ScreenSize().x, app.ScreenSize().y, ms);
+          return pixel::quit;
+        }
+
+        app.FillRect(vu2d(0, 0), app.ScreenSize() - vu2d(1, 1), Pixel(frame++ % 256, 64, 128));
+
+        return pixel::ok;
+      }),
+  });
+
+  app.Launch();
+
+  return 0;
+}
@@ -110,6 +110,10 @@
 #  error "Unsupported platform."
 #endif
 
+#if defined(__x86_64__) || defined(__i386__)
+#  define PIXEL_X86
+#endif
+
 #define PIXEL_VERSION_MAJOR 3
 #define PIXEL_VERSION_MINOR 0
 #define PIXEL_VERSION_PATCH 0
@@ -118,19 +122,49 @@
 
 #define IGNORE(x) (void(x))
 
+// Timeline tracing is only compiled in when PIXEL_TRACE is defined, otherwise these macros expand to nothing
+#ifdef PIXEL_TRACE
+#  define PIXEL_CONCAT_(a, b) a##b
+#  define PIXEL_CONCAT(a, b) PIXEL_CONCAT_(a, b)
+
+#  define PIXEL_SCOPE(name) pixel::TraceScope PIXEL_CONCAT(pTraceScope, __LINE__)(name)
+#  define PIXEL_TRACE_THREAD(name) pixel::Tracer::NameThread(name)
+#else
+#  define PIXEL_SCOPE(name)
+#  define PIXEL_TRACE_THREAD(name)
+#endif
+
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <istream>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <string>
 #include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#ifdef PIXEL_X86
+#  include <immintrin.h>
+#endif
+
 /*
 ___________________________
 
@@ -139,6 +173,7 @@ ___________________________
 
 */
 
+#define GLFW_INCLUDE_GLEXT
 #include <GLFW/glfw3.h>
 
 namespace pixel {
@@ -288,6 +323,28 @@ namespace pixel {
   };
 
   enum class DrawingMode : uint8_t { NO_ALPHA, FULL_ALPHA, MASK };
+  enum class TextMode : uint8_t { DECAL, LAYER };
+  enum class FilterMode : uint8_t { NEAREST, BILINEAR };
+  enum class Phase : uint8_t { INPUT, CLEAR, UPDATE, UPLOAD, DECALS, DISPLAY };
+
+  // Percentiles, in milliseconds, of the frame or phase times kept by the profiler
+  struct FrameStats {
+    float    p50    = 0.0f;
+    float    p95    = 0.0f;
+    float    p99    = 0.0f;
+    float    max    = 0.0f;
+    uint32_t frames = 0;
+  };
+
+  // Counters of the sprite pixel pool. Hits are allocations served by a block freed earlier, and bytes in use count
+  // whole blocks, so they include the rounding up to the size class
+  struct PoolStats {
+    uint64_t allocations  = 0;
+    uint64_t hits         = 0;
+    uint64_t bytes_in_use = 0;
+    uint64_t bytes_cached = 0;
+    float    hit_rate     = 0.0f;
+  };
 
   template <class T>
   struct v2d {
@@ -296,7 +353,6 @@ namespace pixel {
 
     v2d() : x(0), y(0) {}
     v2d(T x, T y) : x(x), y(y) {}
-    v2d(const v2d& v) : x(v.x), y(v.y) {}
 
     T prod() const noexcept { return x * y; }
     T mod() const noexcept { return sqrt((x * x) + (y * y)); }
@@ -391,6 +447,28 @@ namespace pixel {
   typedef v2d<double>   vd2d;
   typedef v2d<float>    vf2d;
 
+  enum class Input : uint8_t {
+    KEY,
+    MOUSE_BUTTON,
+    MOUSE_MOVE,
+    MOUSE_WHEEL,
+    MOUSE_FOCUS,
+    KEY_FOCUS,
+    WINDOW_SIZE,
+    WINDOW_POS,
+  };
+
+  // One change of input as the platform delivered it, stamped with the time it was received. Code is the key or mouse
+  // button, state whether it went down or focus was gained, and value the cursor position in screen pixels, the wheel
+  // offset, or the new size or position of the window
+  struct InputEvent {
+    pixel::Input                          type;
+    uint16_t                              code  = 0;
+    bool                                  state = false;
+    vd2d                                  value;
+    std::chrono::steady_clock::time_point time;
+  };
+
   template <typename T>
   std::string to_string(const v2d<T>& vector) {
     return std::to_string(vector.x) + ", " + std::to_string(vector.y);
@@ -449,10 +527,216 @@ namespace pixel {
 
   Pixel RandPixel() { return Pixel(rand() % 255, rand() % 255, rand() % 255, rand() % 255); }
 
+  // Fixed point "source over" compositing shared by every blending path of the CPU layer. Each channel is computed as
+  // round((src * a + dst * (255 - a)) / 255) and the result is always opaque. The widest kernel supported by the
+  // running CPU (AVX2, SSE2 or plain C++) is picked on first use, and all of them produce identical results
+  class Blend final {
+   public:
+    static Pixel Over(const Pixel& src, const Pixel& dst);
+    static void  Fill(Pixel* dst, size_t count, const Pixel& src);
+    static void  Buffer(const Pixel* src, Pixel* dst, size_t count);
+
+    // Sets count pixels to color without blending. Streaming stores bypass the cache, for buffers too large to still
+    // be cached by the time they are drawn to again
+    static void Clear(Pixel* dst, size_t count, const Pixel& color, bool stream = false);
+
+    // Scales the distance of every channel to color by keep / 256, rounding towards color, so repeated fades always
+    // reach it exactly
+    static void Fade(Pixel* dst, size_t count, const Pixel& color, uint8_t keep);
+
+    // Multiplies every channel of src by the one of tint, as round(src * tint / 255). Src and dst may be the same
+    static void Modulate(const Pixel* src, Pixel* dst, size_t count, const Pixel& tint);
+
+    // Copies the pixels of src that are fully opaque, and leaves dst untouched under all the others
+    static void Mask(const Pixel* src, Pixel* dst, size_t count);
+
+    // Interpolates every channel from a to b as (a * (256 - weight) + b * weight + 128) / 256, weight going up to 256
+    static Pixel Lerp(const Pixel& a, const Pixel& b, uint16_t weight);
+    static void  Lerp(const Pixel* a, const Pixel* b, Pixel* dst, size_t count, uint16_t weight);
+
+    // Interpolates every pixel of dst from src[columns[i]] to the pixel after it, by weights[i] as in Lerp
+    static void Resample(const Pixel* src, Pixel* dst, size_t count, const uint32_t* columns, const uint16_t* weights);
+
+    // Writes every pixel of src times times in a row, until count pixels of dst are written. Zero times writes nothing
+    static void Repeat(const Pixel* src, Pixel* dst, size_t count, uint32_t times);
+
+    static const char* Kernel();
+
+   private:
+    struct kernels_t {
+      const char* name;
+      void (*fill)(Pixel*, size_t, const Pixel&);
+      void (*buffer)(const Pixel*, Pixel*, size_t);
+      void (*clear)(Pixel*, size_t, const Pixel&, bool);
+      void (*fade)(Pixel*, size_t, const Pixel&, uint8_t);
+      void (*modulate)(const Pixel*, Pixel*, size_t, const Pixel&);
+      void (*mask)(const Pixel*, Pixel*, size_t);
+      void (*lerp)(const Pixel*, const Pixel*, Pixel*, size_t, uint16_t);
+      void (*resample)(const Pixel*, Pixel*, size_t, const uint32_t*, const uint16_t*);
+      void (*repeat)(const Pixel*, Pixel*, size_t, uint32_t);
+    };
+
+    // Every kernel table the running CPU supports, from scalar to the widest, which is the one pKernels() keeps
+    static std::vector<kernels_t> pAvailable();
+    static const kernels_t&       pKernels();
+
+    // tests/kernels.cpp checks every vector kernel against its scalar twin
+    friend class KernelTest;
+
+    static void pFillScalar(Pixel* dst, size_t count, const Pixel& src);
+    static void pBufferScalar(const Pixel* src, Pixel* dst, size_t count);
+    static void pClearScalar(Pixel* dst, size_t count, const Pixel& color, bool stream);
+    static void pFadeScalar(Pixel* dst, size_t count, const Pixel& color, uint8_t keep);
+    static void pModulateScalar(const Pixel* src, Pixel* dst, size_t count, const Pixel& tint);
+    static void pMaskScalar(const Pixel* src, Pixel* dst, size_t count);
+    static void pLerpScalar(const Pixel* a, const Pixel* b, Pixel* dst, size_t count, uint16_t weight);
+    static void pResampleScalar(const Pixel* src, Pixel* dst, size_t count, const uint32_t* columns, const uint16_t* w);
+    static void pRepeatScalar(const Pixel* src, Pixel* dst, size_t count, uint32_t times);
+
+#ifdef PIXEL_X86
+    static void pFillSSE2(Pixel* dst, size_t count, const Pixel& src);
+    static void pBufferSSE2(const Pixel* src, Pixel* dst, size_t count);
+    static void pClearSSE2(Pixel* dst, size_t count, const Pixel& color, bool stream);
+    static void pFadeSSE2(Pixel* dst, size_t count, const Pixel& color, uint8_t keep);
+    static void pModulateSSE2(const Pixel* src, Pixel* dst, size_t count, const Pixel& tint);
+    static void pMaskSSE2(const Pixel* src, Pixel* dst, size_t count);
+    static void pLerpSSE2(const Pixel* a, const Pixel* b, Pixel* dst, size_t count, uint16_t weight);
+    static void pResampleSSE2(const Pixel* src, Pixel* dst, size_t count, const uint32_t* columns, const uint16_t* w);
+    static void pRepeatSSE2(const Pixel* src, Pixel* dst, size_t count, uint32_t times);
+    static void pFillAVX2(Pixel* dst, size_t count, const Pixel& src);
+    static void pBufferAVX2(const Pixel* src, Pixel* dst, size_t count);
+    static void pClearAVX2(Pixel* dst, size_t count, const Pixel& color, bool stream);
+    static void pFadeAVX2(Pixel* dst, size_t count, const Pixel& color, uint8_t keep);
+    static void pModulateAVX2(const Pixel* src, Pixel* dst, size_t count, const Pixel& tint);
+    static void pMaskAVX2(const Pixel* src, Pixel* dst, size_t count);
+    static void pLerpAVX2(const Pixel* a, const Pixel* b, Pixel* dst, size_t count, uint16_t weight);
+#endif
+  };
+
+  void BlendBuffer(const Pixel* src, Pixel* dst, size_t count);
+
+  // Particles kept as separate arrays of x, y, velocity and colour, each aligned to a cache line, so integration
+  // streams through contiguous floats with vector kernels picked for the running CPU. Particles are removed by moving
+  // the last one into their slot, so indices are not stable across Kill()
+  class ParticleSystem final {
+   public:
+    ParticleSystem(uint32_t capacity = 0);
+    ~ParticleSystem();
+
+    ParticleSystem(const ParticleSystem& other) = delete;
+    ParticleSystem& operator=(const ParticleSystem& other) = delete;
+
+   public:
+    uint32_t Emit(const vf2d& position, const vf2d& velocity, const Pixel& color = White);
+    void     Kill(uint32_t index);
+    void     Clear();
+    void     Reserve(uint32_t capacity);
+
+    // Accelerates and moves every particle by one step, bouncing those that leave the box from min to max back into it
+    void Integrate(float et, const vf2d& acceleration = vf2d(0.0f, 0.0f));
+    void Integrate(float et, const vf2d& acceleration, const vf2d& min, const vf2d& max);
+
+    uint32_t Size() const;
+
+    float* X() const;
+    float* Y() const;
+    float* VX() const;
+    float* VY() const;
+    Pixel* Colors() const;
+
+    static const char* Kernel();
+
+   private:
+    typedef struct step {
+      float et;
+      vf2d  acceleration;
+      vf2d  min;
+      vf2d  max;
+    } step_t;
+
+    struct kernels_t {
+      const char* name;
+      void (*integrate)(float*, float*, float*, float*, size_t, const step_t&);
+    };
+
+    // Every kernel table the running CPU supports, from scalar to the widest, which is the one pKernels() keeps
+    static std::vector<kernels_t> pAvailable();
+    static const kernels_t&       pKernels();
+
+    // tests/kernels.cpp checks every vector kernel against its scalar twin
+    friend class KernelTest;
+
+    static void pIntegrateScalar(float* x, float* y, float* vx, float* vy, size_t count, const step_t& step);
+
+#ifdef PIXEL_X86
+    static void pIntegrateSSE2(float* x, float* y, float* vx, float* vy, size_t count, const step_t& step);
+    static void pIntegrateAVX2(float* x, float* y, float* vx, float* vy, size_t count, const step_t& step);
+#endif
+
+    template <typename T>
+    static void pGrow(T*& array, uint32_t size, uint32_t capacity);
+    template <typename T>
+    static void pFree(T* array);
+
+   private:
+    uint32_t pSize     = 0;
+    uint32_t pCapacity = 0;
+
+    float* pX      = nullptr;
+    float* pY      = nullptr;
+    float* pVX     = nullptr;
+    float* pVY     = nullptr;
+    Pixel* pColors = nullptr;
+
+    static constexpr size_t pAlignment = 64;
+  };
+
+  // Pixel storage shared by every sprite, handed out in blocks aligned to a cache line. Blocks come in power of two
+  // size classes and freed ones are kept for reuse, up to pMaxCached bytes, so sprites created and destroyed every
+  // frame stop reaching the system allocator. A header in front of each block remembers its class
+  class SpritePool final {
+   public:
+    static Pixel* Allocate(uint32_t pixels);
+    static void   Free(Pixel* buffer);
+
+    // Gives every cached block back to the system
+    static void Trim();
+
+    static PoolStats Stats();
+
+   private:
+    typedef struct block_header {
+      uint32_t size_class;
+      uint32_t pixels;
+    } block_header_t;
+
+    static SpritePool& pInstance();
+
+    static uint32_t pSizeClass(uint32_t pixels);
+    static size_t   pBlockBytes(uint32_t size_class, uint32_t pixels);
+
+   private:
+    std::mutex                      pMutex;
+    std::vector<std::vector<void*>> pFree = std::vector<std::vector<void*>>(pClasses);
+
+    uint64_t pAllocations = 0;
+    uint64_t pHits        = 0;
+    uint64_t pBytesInUse  = 0;
+    uint64_t pBytesCached = 0;
+
+    // Classes go from 64 to 4M pixels, larger buffers are allocated on their own and never cached
+    static constexpr uint32_t pMinClassBits = 6;
+    static constexpr uint32_t pClasses      = 17;
+    static constexpr uint32_t pUnpooled     = 0xFFFFFFFF;
+    static constexpr size_t   pAlignment    = 64;
+    static constexpr size_t   pHeaderBytes  = 64;
+    static constexpr uint64_t pMaxCached    = 64 << 20;
+  };
+
   class Sprite final {
    public:
     Sprite(const std::string& filename);
-    Sprite(uint32_t w, uint32_t h);
+    Sprite(uint32_t w, uint32_t h, bool initialize = true);
     ~Sprite();
 
     friend class Application;
@@ -478,10 +762,23 @@ namespace pixel {
 
    private:
     vu2d pSize;
-    vf2d pUvScale = vf2d(1.0f, 1.0f);
+    vf2d pUvScale  = vf2d(1.0f, 1.0f);
+    vf2d pUvOffset = vf2d(0.0f, 0.0f);
 
     Pixel*   pBuffer   = nullptr;
     uint32_t pBufferId = 0xFFFFFFFF;
+
+   private:
+    // Where a registered sprite sits inside an atlas page. The page only keeps a weak reference, so destroyed sprites
+    // free their space the next time the page is repacked
+    typedef struct atlas_entry {
+      Sprite*  sprite;
+      uint32_t page;
+      vu2d     pos;
+      vu2d     size;
+    } atlas_entry_t;
+
+    std::shared_ptr<atlas_entry_t> pAtlasEntry;
   };
 
   struct SpriteRef {
@@ -509,13 +806,19 @@ namespace pixel {
     void DisplayFrame();
     void PrepareDrawing();
     void DrawLayerQuad();
-    void DrawDecalQuad(const SpriteRef& sprite);
+    void DrawDecalQuads(const std::vector<SpriteRef>& sprites);
 
     uint32_t CreateTexture(uint32_t width, uint32_t height);
     uint32_t DeleteTexture(uint32_t id);
     void     UpdateTexture(uint32_t id, Sprite* spr);
+    void     UpdateTexture(uint32_t id, const vu2d& pos, Sprite* spr);
     void     UpdateTexture(uint32_t id, uint32_t w, uint32_t h, Pixel* buffer);
+    void     UpdateTexture(uint32_t                                  id,
+                           const vu2d&                               size,
+                           const std::vector<std::pair<vu2d, vu2d>>& regions,
+                           Pixel*                                    buffer);
     void     ApplyTexture(uint32_t id);
+    void     DeleteBuffers();
 
     void UpdateViewport(const vu2d& pos, const vu2d& size);
     void ClearBuffer(Pixel p, bool depth);
@@ -523,6 +826,61 @@ namespace pixel {
    private:
     Application* App;
     GLFWwindow*  pWindow;
+
+   private:
+    // Entry points newer than OpenGL 1.1 are not guaranteed to be exported by the system libGL, so they are resolved
+    // at runtime and left null when the context does not support them
+    struct {
+      PFNGLGENBUFFERSPROC     GenBuffers     = nullptr;
+      PFNGLDELETEBUFFERSPROC  DeleteBuffers  = nullptr;
+      PFNGLBINDBUFFERPROC     BindBuffer     = nullptr;
+      PFNGLBUFFERDATAPROC     BufferData     = nullptr;
+      PFNGLBUFFERSTORAGEPROC  BufferStorage  = nullptr;
+      PFNGLMAPBUFFERRANGEPROC MapBufferRange = nullptr;
+      PFNGLUNMAPBUFFERPROC    UnmapBuffer    = nullptr;
+      PFNGLFENCESYNCPROC      FenceSync      = nullptr;
+      PFNGLCLIENTWAITSYNCPROC ClientWaitSync = nullptr;
+      PFNGLDELETESYNCPROC     DeleteSync     = nullptr;
+      PFNGLTEXSTORAGE2DPROC   TexStorage2D   = nullptr;
+    } pGl;
+
+    typedef struct pixel_buffer {
+      uint32_t id      = 0;
+      Pixel*   mapping = nullptr;
+      GLsync   fence   = nullptr;
+    } pixel_buffer_t;
+
+    static constexpr uint32_t pPixelBufferCount = 3;
+
+    pixel_buffer_t pPixelBuffers[pPixelBufferCount];
+    uint32_t       pPixelBufferIndex = 0;
+    size_t         pPixelBufferSize  = 0;
+
+    void pDeletePixelBuffers();
+
+   private:
+    typedef struct decal_vertex {
+      float pos[2];
+      float uv[4];
+      Pixel tint;
+    } decal_vertex_t;
+
+    // Consecutive quads in the vertex buffer sharing one texture, drawn with a single call
+    typedef struct decal_run {
+      uint32_t texture;
+      uint32_t first;
+      uint32_t count;
+      vf2d     min;
+      vf2d     max;
+    } decal_run_t;
+
+    // How many runs back a quad may be moved to join one with the same texture
+    static constexpr uint32_t pDecalLookback = 16;
+
+    std::vector<decal_vertex_t> pDecalVertices;
+    std::vector<decal_run_t>    pDecalRuns;
+    std::vector<uint32_t>       pDecalRunOf;
+    uint32_t                    pDecalBuffer = 0;
   };
 
   class Platform final {
@@ -530,20 +888,276 @@ namespace pixel {
     friend class Renderer;
     friend class Application;
 
-    void ApplicationStartUp();
-    void ApplicationCleanUp();
-
     rcode CreateGraphics(bool fullscreen, bool vsync, const vu2d& viewpos, const vu2d& viewsize);
     rcode CreateWindowPane(const vu2d& winpos, vu2d& winsize, bool fullscreen);
+    void  DestroyWindowPane();
     void  SetWindowTitle(const std::string& s);
 
-    void StartSystemEventLoop();
-
    private:
     Application* App;
-    GLFWwindow*  pWindow;
+    GLFWwindow*  pWindow = nullptr;
+  };
+
+  // Owns glfw on one thread shared by every window of the process. The first window starts it and it terminates glfw
+  // and stops once the last one is destroyed. Calls glfw only allows on that thread are queued to it, and the events
+  // it receives reach each Application through the window user pointer
+  class PlatformService final {
+   public:
+    static PlatformService& Instance();
+
+    friend class Platform;
+
+   public:
+    void Call(const std::function<void()>& task);
+    void Post(std::function<void()> task);
+
+   private:
+    PlatformService() = default;
+
+    void pEventLoop();
+
+   private:
+    std::mutex                         pMutex;
+    std::thread                        pThread;
+    bool                               pRunning = false;
+    std::vector<std::function<void()>> pTasks;
+
+    // Only touched from the service thread
+    std::vector<GLFWwindow*> pWindows;
+
+    // The loop sleeps until an event or a task arrives. The timeout only bounds how long a lost wake up could stall it
+    static constexpr double pEventTimeout = 0.5;
+  };
+
+  // A work stealing pool of threads, shared by the whole process through Shared(). Every worker owns a queue it runs
+  // newest first, and steals the oldest jobs of the others when it runs dry. Threads that are not workers submit to a
+  // queue of their own, and any thread waiting on jobs runs queued ones meanwhile, so jobs can wait on jobs
+  class JobSystem final {
+   public:
+    typedef std::atomic<uint32_t> counter_t;
+
+    JobSystem(uint32_t threads = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem& other) = delete;
+    JobSystem& operator=(const JobSystem& other) = delete;
+
+    static JobSystem& Shared();
+
+   public:
+    void     Submit(std::function<void()> job, counter_t& counter);
+    void     Wait(counter_t& counter);
+    uint32_t Size() const;
+
+    // Calls body(i) for every i below count, split in chunks of grain indices, or in a few chunks per thread when
+    // grain is 0. Chunks are claimed one at a time, so uneven work still balances
+    template <typename F>
+    void ParallelFor(uint32_t count, F&& body, uint32_t grain = 0);
+
+    // Folds map(i) of every i below count with reduce, which must be associative. Partial results are combined in
+    // chunk order, so the result does not depend on which thread ran what
+    template <typename T, typename M, typename R>
+    T ParallelReduce(uint32_t count, T identity, M&& map, R&& reduce, uint32_t grain = 0);
+
+   private:
+    typedef struct job {
+      std::function<void()> task;
+      counter_t*            counter;
+    } job_t;
+
+    typedef struct job_queue {
+      std::mutex        mutex;
+      std::deque<job_t> jobs;
+    } job_queue_t;
+
+    uint32_t pChunks(uint32_t count, uint32_t grain) const;
+    uint32_t pQueueIndex() const;
+    bool     pRunOne(uint32_t queue);
+    void     pWorker(uint32_t queue);
+
+   private:
+    // Queue 0 takes the jobs of threads outside the pool, the rest belong to one worker each
+    std::vector<std::unique_ptr<job_queue_t>> pQueues;
+    std::vector<std::thread>                  pThreads;
+
+    std::mutex              pSleepMutex;
+    std::condition_variable pWake;
+
+    std::atomic<uint32_t> pPending {0};
+    std::atomic<bool>     pStopping {false};
+  };
+
+  // Tasks that run on a JobSystem as soon as the ones they come after have finished. A task can only come after tasks
+  // added before it, so graphs are acyclic by construction, and can be run any number of times
+  class TaskGraph final {
+   public:
+    uint32_t Add(std::function<void()> task, const std::vector<uint32_t>& after = {});
+    void     Run(JobSystem& jobs);
+
+   private:
+    typedef struct node {
+      std::function<void()> task;
+      std::vector<uint32_t> successors;
+      uint32_t              dependencies = 0;
+      std::atomic<uint32_t> remaining {0};
+    } node_t;
+
+    void pSubmit(JobSystem& jobs, JobSystem::counter_t& counter, uint32_t index);
+
+    std::deque<node_t> pNodes;
+  };
+
+  // Items bucketed by the cell of a uniform grid their position falls in, for finding neighbours without comparing
+  // every pair. Items are inserted, then Build() sorts them by cell with a counting sort into one array, so the items
+  // of a row of cells are contiguous. Positions outside the bounds are kept in the border cells
+  template <typename T>
+  class SpatialGrid final {
+   public:
+    SpatialGrid(const vf2d& min, const vf2d& max, float cell_size);
+
+   public:
+    void Clear();
+    void Insert(const vf2d& position, const T& item);
+    void Build();
+
+    // Calls visit(position, item) for every item within radius of center, or inside the rectangle from min to max
+    template <typename F>
+    void QueryRadius(const vf2d& center, float radius, F&& visit) const;
+    template <typename F>
+    void QueryRect(const vf2d& min, const vf2d& max, F&& visit) const;
+
+    uint32_t Size() const;
+
+   private:
+    typedef struct entry {
+      vf2d position;
+      T    item;
+    } entry_t;
+
+    vu2d pCell(const vf2d& position) const;
+
+    template <typename F>
+    void pVisit(const vu2d& first, const vu2d& last, F&& visit) const;
+
+   private:
+    vf2d  pMin;
+    float pInvCellSize;
+    vu2d  pCells;
+
+    std::vector<entry_t>  pInserted;
+    std::vector<uint32_t> pInsertedCells;
+
+    // Sorted entries, with the entries of cell i in [pCellStart[i], pCellStart[i + 1])
+    std::vector<entry_t>  pEntries;
+    std::vector<uint32_t> pCellStart;
+  };
+
+  // Barnes-Hut approximation of the inverse square attraction of every body on every other one, for n-body
+  // simulations. Build() sorts the bodies along a Morton curve and stores the tree over them as a flat array in depth
+  // first order, where each node knows the index just past its subtree, so traversals walk it front to back without a
+  // stack. A node is taken as a single body once its size over its distance falls below theta, so a theta of 0 is
+  // exact, and larger ones trade accuracy for speed
+  class QuadTree final {
+   public:
+    QuadTree(float theta = 0.5f, float softening = 0.0f);
+
+   public:
+    void Build(const std::vector<vf2d>& positions, const std::vector<float>& masses);
+
+    // Acceleration of a body at position, in units of g, skipping bodies at exactly that position
+    vf2d Acceleration(const vf2d& position, float g) const;
+
+    // Acceleration of every body of the last Build(), evaluated in parallel in Morton order
+    void Accelerations(JobSystem& jobs, float g, std::vector<vf2d>& out) const;
+
+    void  SetTheta(float theta);
+    float theta() const;
+
+    uint32_t Nodes() const;
+
+   private:
+    typedef struct node {
+      vf2d     center;
+      float    mass;
+      float    size;
+      uint32_t begin;
+      uint32_t end;
+      uint32_t next;
+    } node_t;
+
+    static uint32_t pSpread(uint32_t bits);
+
+    void pBuild(uint32_t begin, uint32_t end, uint32_t shift, float size);
+
+   private:
+    float pTheta;
+    float pSoftening;
+
+    // Morton key in the high half and index of the body in the low half, sorted
+    std::vector<uint64_t> pKeys;
+    std::vector<vf2d>     pPositions;
+    std::vector<float>    pMasses;
+    std::vector<node_t>   pNodes;
+
+    static constexpr uint32_t pLeafSize = 8;
+  };
+
+#ifdef PIXEL_TRACE
+  // Collects timed scopes into buffers owned by the thread that recorded them, so recording never takes a lock once a
+  // thread has registered its buffer. Flush writes everything recorded so far as a Chrome trace, which both
+  // chrome://tracing and Perfetto open
+  class Tracer final {
+   public:
+    static void  NameThread(const char* name);
+    static void  Record(const char*                           name,
+                        std::chrono::steady_clock::time_point begin,
+                        std::chrono::steady_clock::time_point end);
+    static rcode Flush(const std::string& filename);
+
+   private:
+    typedef struct trace_event {
+      const char* name;
+      uint64_t    begin;
+      uint64_t    duration;
+    } trace_event_t;
+
+    // Events are appended in fixed blocks and published through count, so Flush can read a buffer while its thread
+    // keeps recording. Once a thread fills all its blocks further events are dropped
+    static constexpr uint32_t pBlockSize = 4096;
+    static constexpr uint32_t pMaxBlocks = 256;
+
+    typedef struct thread_buffer {
+      uint32_t                                                 id;
+      std::atomic<const char*>                                 name {nullptr};
+      std::array<std::unique_ptr<trace_event_t[]>, pMaxBlocks> blocks;
+      std::atomic<uint64_t>                                    count {0};
+      std::atomic<uint64_t>                                    dropped {0};
+    } thread_buffer_t;
+
+    static thread_buffer_t& pLocalBuffer();
+
+    // Buffers are owned here rather than by their threads, so the events of finished threads still get flushed
+    static inline std::mutex                                    pMutex;
+    static inline std::vector<std::unique_ptr<thread_buffer_t>> pBuffers;
+
+    static inline const std::chrono::steady_clock::time_point pEpoch = std::chrono::steady_clock::now();
   };
 
+  // Records the lifetime of a scope, use it through PIXEL_SCOPE so it disappears when tracing is disabled
+  class TraceScope final {
+   public:
+    TraceScope(const char* name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope& other) = delete;
+    TraceScope& operator=(const TraceScope& other) = delete;
+
+   private:
+    const char*                           pName;
+    std::chrono::steady_clock::time_point pBegin;
+  };
+#endif
+
   static std::map<size_t, uint8_t> pKeyMap;
 
   class Application final {
@@ -554,17 +1168,30 @@ namespace pixel {
       vu2d    position = vu2d(25, 25);
       uint8_t scale    = 2;
 
-      std::string        name = "Pixel";
-      pixel::DrawingMode mode = DrawingMode::FULL_ALPHA;
+      std::string        name      = "Pixel";
+      pixel::DrawingMode mode      = DrawingMode::FULL_ALPHA;
+      pixel::TextMode    text_mode = TextMode::DECAL;
 
       bool  fullscreen   = false;
       bool  vsync        = false;
       bool  clear_buffer = true;
       Pixel buffer_color = Black;
+      float persistence  = 0.0f;
+
+      bool     headless       = false;
+      uint32_t target_fps     = 0;
+      float    fixed_timestep = 0.0f;
 
-      callback_t on_launch = nullptr;
-      callback_t on_update = nullptr;
-      callback_t on_close  = nullptr;
+      bool     tiled_raster   = false;
+      uint32_t raster_threads = 0;
+
+      bool        profiler_overlay = false;
+      std::string trace_file       = "";
+
+      callback_t on_launch       = nullptr;
+      callback_t on_update       = nullptr;
+      callback_t on_fixed_update = nullptr;
+      callback_t on_close        = nullptr;
     } params_t;
 
    public:
@@ -572,6 +1199,7 @@ namespace pixel {
     ~Application();
 
     friend class Platform;
+    friend class PlatformService;
     friend class Sprite;
 
    public:
@@ -587,12 +1215,22 @@ namespace pixel {
 
     void SetName(const std::string& name);
     void SetDrawingMode(pixel::DrawingMode mode);
+    void SetTiledRaster(bool enabled);
+    void SetTextMode(pixel::TextMode mode);
+    void SetProfilerOverlay(bool enabled);
+    void SetTargetFps(uint32_t fps);
+
+    // Fraction of each frame kept under the next one instead of clearing it, for trails that fade out on their own
+    void SetPersistence(float persistence);
 
    public:
     void RegisterSprite(Sprite* spr);
 
    public:
     void Draw(const vu2d& pos, const Pixel& pixel = White);
+    void FillSpan(int32_t y, int32_t x0, int32_t x1, const Pixel& pixel = White);
+    void BlendSpan(int32_t y, int32_t x0, int32_t x1, const Pixel& pixel = White);
+
     void DrawLine(const vu2d& pos1, const vu2d& pos2, const Pixel& pixel = White);
     void DrawString(const vu2d& pos, std::string_view text, uint8_t size = 8, const Pixel& color = White);
 
@@ -605,6 +1243,24 @@ namespace pixel {
     void DrawTriangle(const vu2d& pos1, const vu2d& pos2, const vu2d& pos3, const Pixel& pixel = White);
     void FillTriangle(const vu2d& pos1, const vu2d& pos2, const vu2d& pos3, const Pixel& pixel = White);
 
+    void DrawParticles(const ParticleSystem& particles);
+
+    // Composites a sprite into the layer, under whatever is drawn after it, instead of queueing a decal. Each texel is
+    // written, blended or masked by its own alpha following the drawing mode. Scaled blits take the nearest texel, or
+    // interpolate the four closest ones with FilterMode::BILINEAR
+    void BlitSprite(const vi2d&       pos,
+                    Sprite*           spr,
+                    const vf2d&       scale  = vf2d(1.0f, 1.0f),
+                    const Pixel&      tint   = White,
+                    pixel::FilterMode filter = pixel::FilterMode::NEAREST);
+    void BlitPartialSprite(const vi2d&       pos,
+                           const vu2d&       spos,
+                           const vu2d&       ssize,
+                           Sprite*           spr,
+                           const vf2d&       scale  = vf2d(1.0f, 1.0f),
+                           const Pixel&      tint   = White,
+                           pixel::FilterMode filter = pixel::FilterMode::NEAREST);
+
     void DrawSprite(const vu2d& pos, Sprite* spr, const vf2d& scale = vf2d(1.0f, 1.0f), const Pixel& tint = White);
     void DrawPartialSprite(const vu2d&  pos,
                            const vu2d&  spos,
@@ -639,11 +1295,85 @@ namespace pixel {
     void UpdateMouse(uint32_t x, uint32_t y);
     void UpdateMouseWheel(uint32_t delta);
     void UpdateWindowSize(uint32_t x, uint32_t y);
+    void UpdateWindowPos(int32_t x, int32_t y);
 
     void UpdateViewport();
 
+   private:
+    typedef struct rect {
+      int32_t x0 = 0;
+      int32_t y0 = 0;
+      int32_t x1 = -1;
+      int32_t y1 = -1;
+    } rect_t;
+
+    typedef struct command {
+      enum type_t : uint8_t { POINT, SPAN, LINE, CIRCLE, FILL_CIRCLE, FILL_RECT, FILL_TRIANGLE };
+
+      type_t             type;
+      pixel::DrawingMode mode = pixel::DrawingMode::NO_ALPHA;
+      Pixel              pixel;
+      vi2d               pos[3];
+      uint32_t           radius = 0;
+      rect_t             bounds;
+    } command_t;
+
+    // A sprite blit with its source rect clamped to the sprite and its destination clipped to the screen. Rows are read
+    // straight from the sprite when columns map one to one, texels are repeated for integer scales, picked through
+    // pBlitColumns for other scales, or interpolated with pBlitWeights
+    typedef struct blit {
+      enum type_t : uint8_t { COPY, REPEAT, NEAREST, BILINEAR };
+
+      type_t       type;
+      const Pixel* pixels;
+      uint32_t     pitch;
+      vu2d         size;
+      vi2d         pos;
+      vf2d         scale;
+      Pixel        tint;
+      rect_t       bounds;
+    } blit_t;
+
+    bool ClipSpan(const rect_t& clip, int32_t& y, int32_t& x0, int32_t& x1) const;
+
+    template <typename F>
+    void pDispatch(pixel::DrawingMode mode, const Pixel& pixel, F&& rasterize);
+
+    template <pixel::DrawingMode M>
+    void pPlot(const rect_t& clip, int32_t x, int32_t y, const Pixel& pixel);
+    template <pixel::DrawingMode M>
+    void pSpan(const rect_t& clip, int32_t y, int32_t x0, int32_t x1, const Pixel& pixel);
+
+    template <pixel::DrawingMode M>
+    void pDrawLine(const rect_t& clip, const vu2d& pos1, const vu2d& pos2, const Pixel& pixel);
+    template <pixel::DrawingMode M>
+    void pDrawCircle(const rect_t& clip, const vu2d& pos, uint32_t radius, const Pixel& pixel);
+    template <pixel::DrawingMode M>
+    void pFillCircle(const rect_t& clip, const vu2d& pos, uint32_t radius, const Pixel& pixel);
+    template <pixel::DrawingMode M>
+    void pFillRect(const rect_t& clip, const vu2d& pos1, const vu2d& pos2, const Pixel& pixel);
+    template <pixel::DrawingMode M>
+    void pFillTriangle(const rect_t& clip, const vu2d& pos1, const vu2d& pos2, const vu2d& pos3, const Pixel& pixel);
+    template <pixel::DrawingMode M>
+    void pDrawParticles(const ParticleSystem& particles);
+    template <pixel::DrawingMode M>
+    void pBlitRows(const blit_t& blit, int32_t y0, int32_t y1);
+
+    void pSubmit(command_t command);
+    void pSubmit(command_t command, pixel::DrawingMode mode);
+    void pExecute(const command_t& command, const rect_t& clip);
+    void pRasterizeCommands();
+
+    JobSystem& pRasterJobs();
+
+    void pMarkDirty(const rect_t& rect);
+    void pClearDrawnTiles();
+    void pUploadDirtyTiles();
+
     void UpdateMouseState(uint32_t button, bool state);
     void UpdateKeyState(uint32_t key, bool state);
+    void UpdateMousePos(const vd2d& pos);
+    void UpdateMouseWheel(const vd2d& offset);
 
     void UpdateMouseFocus(bool state);
     void UpdateKeyFocus(bool state);
@@ -662,9 +1392,22 @@ namespace pixel {
     const Button& Mouse(pixel::Mouse button) const;
     const Button& Key(Key key) const;
 
+    const std::vector<InputEvent>& InputEvents() const;
+
     float    et() const;
+    float    alpha() const;
     uint32_t fps() const;
 
+    FrameStats FrameTimes() const;
+    FrameStats FrameTimes(pixel::Phase phase) const;
+
+    // Rasterizes the primitives still queued by the tiled rasterizer first, so the layer holds everything drawn so far
+    const Pixel*                  Frame();
+    const std::vector<SpriteRef>& Decals() const;
+
+    // The job system shared with the library, for splitting on_update work across threads
+    JobSystem& Jobs() const;
+
    private:
     vu2d pWindowSize;
     vu2d pWindowPos;
@@ -685,31 +1428,66 @@ namespace pixel {
     bool pVsync      = false;
     bool pFullScreen = false;
 
+    // Headless applications never touch the platform or the renderer: frames are only drawn into pBuffer and the
+    // decals of the last one are kept in pSpritesRecorded
+    bool  pHeadless      = false;
+    float pFixedTimestep = 0.0f;
+
+    // With a fixed timestep and on_fixed_update, the simulation runs in whole steps of pFixedTimestep out of the time
+    // accumulated so far, at most pMaxFixedSteps per frame, and alpha() is how far into the next step the frame is
+    static constexpr uint32_t pMaxFixedSteps = 8;
+
+    float pFixedAccumulator = 0.0f;
+    float pFixedAlpha       = 0.0f;
+
+    // Frames are paced to pTargetFps, when set, by sleeping until shortly before the deadline and spinning the rest of
+    // the way, since a sleep alone can wake up late by a good part of a 240 Hz frame
+    static constexpr std::chrono::microseconds pSpinMargin {1000};
+
+    uint32_t                              pTargetFps = 0;
+    std::chrono::steady_clock::time_point pNextFrame;
+
+    std::vector<SpriteRef> pSpritesRecorded;
+
     bool  pClearBuffer = true;
     Pixel pBufferColor = Black;
 
-    std::atomic<bool> pHasBeenClosed {false};
     std::atomic<bool> pThreadRunning {false};
     std::atomic<bool> pWantsToClose {false};
 
+    // Shared with the engine thread, which sets it last and may still be notifying waiters after one of them returned
+    // from EnsureClosed and destroyed the application
+    std::shared_ptr<std::atomic<bool>> pHasBeenClosed = std::make_shared<std::atomic<bool>>(false);
+
    private:
     vu2d pMousePos;
     vd2d pMouseWheel;
 
-    Button pMouseButtons[3]    = {};
-    bool   pMouseButtonsOld[3] = {};
-    bool   pMouseButtonsNew[3] = {};
-
-    Button pKeyboardKeys[512]    = {};
-    bool   pKeyboardKeysOld[512] = {};
-    bool   pKeyboardKeysNew[512] = {};
+    Button pMouseButtons[8]   = {};
+    Button pKeyboardKeys[512] = {};
 
     bool pHasInputFocus = false;
     bool pHasMouseFocus = false;
 
+    // Input reaches the engine thread through a single producer, single consumer ring. The Update* functions push
+    // timestamped events from the event thread, and each frame starts by draining them in order, so a press and release
+    // within one frame still shows up as pressed. When the ring is full new events are dropped and counted
+    static constexpr uint32_t pInputCapacity = 1024;
+
+    std::array<InputEvent, pInputCapacity> pInputRing;
+    std::atomic<uint32_t>                  pInputHead {0};
+    std::atomic<uint32_t>                  pInputTail {0};
+    std::atomic<uint32_t>                  pInputDropped {0};
+
+    std::vector<InputEvent> pInputEvents;
+    std::vector<uint16_t>   pKeysChanged;
+
+    void pPushInput(const InputEvent& event);
+    void pDrainInput();
+
    private:
-    std::chrono::system_clock::time_point pClock1;
-    std::chrono::system_clock::time_point pClock2;
+    std::chrono::steady_clock::time_point pClock1;
+    std::chrono::steady_clock::time_point pClock2;
     std::chrono::duration<float>          pElapsedTimer;
 
     float    pElapsedTime = 0.0f;
@@ -718,16 +1496,131 @@ namespace pixel {
     uint32_t pFrameRate   = 0;
 
    private:
-    Sprite*  pFontSprite;
-    Pixel*   pBuffer   = nullptr;
-    uint32_t pBufferId = 0xFFFFFFFF;
+    // Phase times, in microseconds, of the most recent frames, with the whole frame in the last column. Only the engine
+    // thread writes, and it publishes a slot through pProfileHead once filled, so any thread can read them lock free.
+    // A reader racing the writer may see one half written slot, which is good enough for percentiles
+    static constexpr uint32_t pProfileFrames = 256;
+    static constexpr uint32_t pPhaseCount    = 6;
+
+    static constexpr const char* pPhaseNames[pPhaseCount + 1] = {
+        "input", "clear", "update", "upload", "decals", "display", "frame"};
+
+    typedef std::array<std::atomic<uint32_t>, pPhaseCount + 1> frame_profile_t;
+
+    std::array<frame_profile_t, pProfileFrames> pProfile;
+    std::atomic<uint64_t>                       pProfileHead {0};
+
+    std::chrono::steady_clock::time_point pPhaseStart;
+    std::array<uint32_t, pPhaseCount>     pPhaseTimes = {};
+
+    bool pProfilerOverlay = false;
+
+    // Where the trace is written once the engine loop ends, when built with PIXEL_TRACE
+    std::string pTraceFile = "";
+
+    void       pMarkPhase(pixel::Phase phase);
+    void       pPushProfile();
+    void       pDrawProfilerOverlay();
+    FrameStats pFrameStats(uint32_t column) const;
+
+   private:
+    // The built-in font is a strip of fixed size cells, one per printable ASCII character starting at the space
+    static constexpr uint32_t pGlyphWidth  = 19;
+    static constexpr uint32_t pGlyphHeight = 32;
+    static constexpr uint32_t pGlyphCount  = 95;
+
+    typedef struct glyph {
+      vf2d uvtl;
+      vf2d uvbr;
+    } glyph_t;
+
+    // Font sprite UVs of every glyph, filled once the font sprite is created and registered
+    std::array<glyph_t, pGlyphCount> pGlyphs;
+
+    pixel::TextMode pTextMode = pixel::TextMode::DECAL;
+
+   private:
+    Sprite*  pFontSprite = nullptr;
+    Pixel*   pBuffer     = nullptr;
+    uint32_t pBufferId   = 0xFFFFFFFF;
 
     std::vector<SpriteRef> pSpritesPending;
     pixel::DrawingMode     pDrawingMode = pixel::DrawingMode::NO_ALPHA;
 
+    rect_t pScreenRect;
+
+   private:
+    // Small registered sprites share a few atlas pages, so decals drawn from different sprites still batch into a
+    // single texture run. Pages are filled with a skyline packer, and when one runs out of space it is repacked into a
+    // texture twice as large, up to pAtlasMaxSize, before a new page is opened
+    typedef struct skyline {
+      uint32_t x;
+      uint32_t y;
+      uint32_t width;
+    } skyline_t;
+
+    typedef struct atlas_page {
+      uint32_t                                          texture = 0xFFFFFFFF;
+      uint32_t                                          size    = 0;
+      std::vector<skyline_t>                            skyline;
+      std::vector<std::weak_ptr<Sprite::atlas_entry_t>> entries;
+    } atlas_page_t;
+
+    static constexpr uint32_t pAtlasMinSize     = 256;
+    static constexpr uint32_t pAtlasMaxSize     = 2048;
+    static constexpr uint32_t pAtlasSpriteLimit = 256;
+    static constexpr uint32_t pAtlasPadding     = 1;
+
+    std::vector<atlas_page_t> pAtlasPages;
+    std::vector<uint32_t>     pRetiredTextures;
+
+    bool pAtlasInsert(atlas_page_t& page, const vu2d& size, vu2d& pos);
+    bool pAtlasRepack(uint32_t index, uint32_t size, Sprite* spr);
+    void pAtlasPlace(Sprite* spr, uint32_t index, const vu2d& pos);
+
+   private:
+    // The screen is split in square tiles, used both as the work unit of the tiled rasterizer and to track which parts
+    // of the buffer were drawn to (and so need clearing next frame) and which need uploading to the layer texture
+    static constexpr uint32_t pTileSize = 64;
+
+    enum : uint8_t { TILE_DRAWN = 1, TILE_UPLOAD = 2 };
+    enum : uint8_t { TILE_KEEP, TILE_CLEAR, TILE_FADE };
+
+    uint32_t             pTilesX = 0;
+    uint32_t             pTilesY = 0;
+    std::vector<uint8_t> pDirtyTiles;
+
+    // With persistence, tiles keep fading for pFadeFrames after they were last drawn, which is when whatever was on
+    // them has reached the buffer colour
+    std::vector<uint16_t> pTileFade;
+    std::vector<uint8_t>  pTileOps;
+    uint8_t               pFadeKeep   = 0;
+    uint16_t              pFadeFrames = 0;
+
+    // Canvases of at least this many pixels are cleared with streaming stores, split by tile row across threads
+    static constexpr uint32_t pLargeCanvas = 1 << 22;
+
+    // Source column read by each destination column of a scaled blit, and with bilinear filtering the weight of the
+    // column after it. Blits of at least pLargeBlit pixels are split across threads in bands of pBlitBand rows
+    std::vector<uint32_t> pBlitColumns;
+    std::vector<uint16_t> pBlitWeights;
+
+    static constexpr uint32_t pLargeBlit = 1 << 16;
+    static constexpr uint32_t pBlitBand  = 32;
+
+    std::vector<std::pair<vu2d, vu2d>> pUploadRegions;
+
+    bool     pTiledRaster   = false;
+    uint32_t pRasterThreads = 0;
+
+    std::vector<command_t>             pCommands;
+    std::vector<std::vector<uint32_t>> pTileBins;
+    std::unique_ptr<JobSystem>         pRasterPool;
+
    private:
     callback_t pOnLaunch;
     callback_t pOnUpdate;
+    callback_t pOnFixedUpdate;
     callback_t pOnClose;
 
     Platform pPlatform;
@@ -736,7 +1629,13 @@ namespace pixel {
    private:
     void pStartThread();
     void pEngineThread();
+    static void pSignalClosed(const std::shared_ptr<std::atomic<bool>>& closed);
+    void pFixedUpdate();
+    void pWaitNextFrame();
     void pCreateFont();
+    void pBuildGlyphTable();
+    void pDrawStringDecal(const vu2d& pos, std::string_view text, uint8_t size, const Pixel& color);
+    void pDrawStringLayer(const vu2d& pos, std::string_view text, uint8_t size, const Pixel& color);
   };
 }
 
@@ -764,701 +1663,2491 @@ namespace pixel {
   bool Pixel::operator==(const Pixel& p) const { return n == p.n; }
   bool Pixel::operator!=(const Pixel& p) const { return n != p.n; }
 
-  Sprite::Sprite(uint32_t w, uint32_t h) {
-    if (pBuffer) delete[] pBuffer;
+  Pixel Blend::Over(const Pixel& src, const Pixel& dst) {
+    uint32_t a = src.v.a;
+    uint32_t c = 255 - a;
 
-    pSize.x = w;
-    pSize.y = h;
+    // x / 255 rounded to the nearest integer, valid for every x <= 255 * 255
+    auto div255 = [](uint32_t x) -> uint8_t { return (x + 128 + ((x + 128) >> 8)) >> 8; };
 
-    pBuffer = new Pixel[w * h];
-    for (uint32_t i = 0; i < w * h; i++) {
-      pBuffer[i] = Pixel();
-    }
+    return Pixel(div255(src.v.r * a + dst.v.r * c),
+                 div255(src.v.g * a + dst.v.g * c),
+                 div255(src.v.b * a + dst.v.b * c));
   }
 
-  Sprite::~Sprite() {
-    if (pBuffer) delete[] pBuffer;
+  void Blend::Fill(Pixel* dst, size_t count, const Pixel& src) { pKernels().fill(dst, count, src); }
+  void Blend::Buffer(const Pixel* src, Pixel* dst, size_t count) { pKernels().buffer(src, dst, count); }
+
+  void Blend::Clear(Pixel* dst, size_t count, const Pixel& color, bool stream) {
+    pKernels().clear(dst, count, color, stream);
   }
 
-  Sprite::Sprite(const std::string& filename) {
-    if (FileUtil::LoadImage(this, filename) != rcode::ok)
-      throw std::runtime_error(std::string("Cannot open: ") + filename);
+  void Blend::Fade(Pixel* dst, size_t count, const Pixel& color, uint8_t keep) {
+    pKernels().fade(dst, count, color, keep);
   }
 
-  Sprite::Sprite(const Sprite& src) : pSize(src.pSize), pUvScale(src.pUvScale), pBufferId(src.pBufferId) {
-    pBuffer = new Pixel[src.pSize.prod()];
+  void Blend::Modulate(const Pixel* src, Pixel* dst, size_t count, const Pixel& tint) {
+    pKernels().modulate(src, dst, count, tint);
+  }
 
-    for (uint32_t i = 0; i < src.pSize.prod(); i++) {
-      pBuffer[i] = src.pBuffer[i];
-    }
+  void Blend::Mask(const Pixel* src, Pixel* dst, size_t count) { pKernels().mask(src, dst, count); }
+
+  // Red and blue, then green and alpha, are interpolated together in the two 16 bit halves of a single word. Neither
+  // half exceeds 255 * 256 + 128, so no carry crosses from one to the other
+  Pixel Blend::Lerp(const Pixel& a, const Pixel& b, uint16_t weight) {
+    uint32_t w = weight;
+    uint32_t c = 256 - weight;
+
+    uint32_t rb = ((a.n & 0x00FF00FF) * c + (b.n & 0x00FF00FF) * w + 0x00800080) >> 8;
+    uint32_t ga = ((a.n >> 8) & 0x00FF00FF) * c + ((b.n >> 8) & 0x00FF00FF) * w + 0x00800080;
+
+    return Pixel((rb & 0x00FF00FF) | (ga & 0xFF00FF00));
   }
 
-  Sprite& Sprite::operator=(const Sprite& rhs) {
-    Sprite copy(rhs);
-    Swap(copy);
-    return *this;
+  void Blend::Lerp(const Pixel* a, const Pixel* b, Pixel* dst, size_t count, uint16_t weight) {
+    pKernels().lerp(a, b, dst, count, weight);
   }
 
-  Sprite::Sprite(Sprite&& src) noexcept {
-    pBuffer = nullptr;
-    Swap(src);
+  void Blend::Resample(const Pixel* src, Pixel* dst, size_t count, const uint32_t* columns, const uint16_t* weights) {
+    pKernels().resample(src, dst, count, columns, weights);
   }
 
-  Sprite& Sprite::operator=(Sprite&& rhs) noexcept {
-    Swap(rhs);
-    return *this;
+  void Blend::Repeat(const Pixel* src, Pixel* dst, size_t count, uint32_t times) {
+    pKernels().repeat(src, dst, count, times);
   }
 
-  Pixel Sprite::GetPixel(uint32_t x, uint32_t y) const {
-    if (x < pSize.x && y < pSize.y) {
-      return pBuffer[y * pSize.x + x];
+  const char* Blend::Kernel() { return pKernels().name; }
+
+  std::vector<Blend::kernels_t> Blend::pAvailable() {
+    std::vector<kernels_t> kernels = {{"scalar",
+                                       &Blend::pFillScalar,
+                                       &Blend::pBufferScalar,
+                                       &Blend::pClearScalar,
+                                       &Blend::pFadeScalar,
+                                       &Blend::pModulateScalar,
+                                       &Blend::pMaskScalar,
+                                       &Blend::pLerpScalar,
+                                       &Blend::pResampleScalar,
+                                       &Blend::pRepeatScalar}};
+#ifdef PIXEL_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse2")) {
+      kernels.push_back({"sse2",
+                         &Blend::pFillSSE2,
+                         &Blend::pBufferSSE2,
+                         &Blend::pClearSSE2,
+                         &Blend::pFadeSSE2,
+                         &Blend::pModulateSSE2,
+                         &Blend::pMaskSSE2,
+                         &Blend::pLerpSSE2,
+                         &Blend::pResampleSSE2,
+                         &Blend::pRepeatSSE2});
+    }
 
-    } else {
-      return Pixel(0, 0, 0, 0);
+    if (__builtin_cpu_supports("avx2")) {
+      kernels.push_back({"avx2",
+                         &Blend::pFillAVX2,
+                         &Blend::pBufferAVX2,
+                         &Blend::pClearAVX2,
+                         &Blend::pFadeAVX2,
+                         &Blend::pModulateAVX2,
+                         &Blend::pMaskAVX2,
+                         &Blend::pLerpAVX2,
+                         &Blend::pResampleSSE2,
+                         &Blend::pRepeatSSE2});
     }
+#endif
+    return kernels;
   }
 
-  void Sprite::SetPixel(uint32_t x, uint32_t y, const Pixel& p) {
-    if (x < pSize.x && y < pSize.y) {
-      pBuffer[y * pSize.x + x] = p;
-    }
+  const Blend::kernels_t& Blend::pKernels() {
+    static const kernels_t kernels = pAvailable().back();
+    return kernels;
   }
 
-  vu2d Sprite::GetSize() const { return pSize; }
+  void Blend::pFillScalar(Pixel* dst, size_t count, const Pixel& src) {
+    for (size_t i = 0; i < count; i++) dst[i] = Over(src, dst[i]);
+  }
 
-  void Sprite::Swap(Sprite& other) noexcept {
-    std::swap(pSize, other.pSize);
-    std::swap(pUvScale, other.pUvScale);
+  void Blend::pBufferScalar(const Pixel* src, Pixel* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) dst[i] = Over(src[i], dst[i]);
+  }
 
-    std::swap(pBuffer, other.pBuffer);
-    std::swap(pBufferId, other.pBufferId);
+  void Blend::pClearScalar(Pixel* dst, size_t count, const Pixel& color, bool stream) {
+    IGNORE(stream);
+    std::fill(dst, dst + count, color);
   }
-}
 
-namespace pixel {
-  Application::Application(Application::params_t params) {
-    if (params.scale <= 0 || params.size.x <= 0 || params.size.y <= 0)
-      throw std::runtime_error("Invalid Application dimensions");
+  void Blend::pFadeScalar(Pixel* dst, size_t count, const Pixel& color, uint8_t keep) {
+    auto fade = [&](uint8_t d, uint8_t c) -> uint8_t {
+      return d >= c ? c + (((d - c) * keep) >> 8) : c - (((c - d) * keep) >> 8);
+    };
 
-    pPlatform.App = this;
-    pRenderer.App = this;
+    for (size_t i = 0; i < count; i++) {
+      Pixel& d = dst[i];
+      d        = Pixel(fade(d.v.r, color.v.r), fade(d.v.g, color.v.g), fade(d.v.b, color.v.b), fade(d.v.a, color.v.a));
+    }
+  }
 
-    pWindowSize = params.size * params.scale;
-    pWindowPos  = params.position;
+  void Blend::pModulateScalar(const Pixel* src, Pixel* dst, size_t count, const Pixel& tint) {
+    auto div255 = [](uint32_t x) -> uint8_t { return (x + 128 + ((x + 128) >> 8)) >> 8; };
 
-    pScreenSize    = params.size;
-    pInvScreenSize = vf2d(1.0f / params.size.x, 1.0f / params.size.y);
-    pScale         = params.scale;
+    for (size_t i = 0; i < count; i++) {
+      Pixel s = src[i];
+      dst[i]  = Pixel(div255(s.v.r * tint.v.r),
+                      div255(s.v.g * tint.v.g),
+                      div255(s.v.b * tint.v.b),
+                      div255(s.v.a * tint.v.a));
+    }
+  }
 
-    pWindowName   = params.name;
-    pWindowTittle = params.name + " - FPS: 0";
+  void Blend::pMaskScalar(const Pixel* src, Pixel* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      if (src[i].v.a == 255) dst[i] = src[i];
+    }
+  }
 
-    pDrawingMode = params.mode;
+  void Blend::pLerpScalar(const Pixel* a, const Pixel* b, Pixel* dst, size_t count, uint16_t weight) {
+    for (size_t i = 0; i < count; i++) dst[i] = Lerp(a[i], b[i], weight);
+  }
 
-    pVsync       = params.vsync;
-    pFullScreen  = params.fullscreen;
-    pClearBuffer = params.clear_buffer;
-    pBufferColor = params.buffer_color;
+  void Blend::pResampleScalar(const Pixel* src, Pixel* dst, size_t count, const uint32_t* columns, const uint16_t* w) {
+    for (size_t i = 0; i < count; i++) dst[i] = Lerp(src[columns[i]], src[columns[i] + 1], w[i]);
+  }
 
-    pOnLaunch = params.on_launch;
-    pOnUpdate = params.on_update;
-    pOnClose  = params.on_close;
+  // Also finishes the SSE2 kernel, which leaves every pixel to this loop when times is zero
+  void Blend::pRepeatScalar(const Pixel* src, Pixel* dst, size_t count, uint32_t times) {
+    if (times == 0) return;
 
-    pCreateFont();
+    for (size_t i = 0; i < count; src++) {
+      for (size_t end = std::min<size_t>(i + times, count); i < end; i++) dst[i] = *src;
+    }
   }
 
-  Application::~Application() { delete pFontSprite; }
+#ifdef PIXEL_X86
+  // The vector kernels widen each channel to 16 bits, where src * a + dst * (255 - a) plus the rounding terms of the
+  // division by 255 never exceed 65535, so the arithmetic matches Blend::Over exactly
 
-  void Application::pStartThread() {
-    pPlatform.ApplicationStartUp();
+  void Blend::pFillSSE2(Pixel* dst, size_t count, const Pixel& src) {
+    const __m128i zero   = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+    const __m128i half   = _mm_set1_epi16(128);
 
-    if (pPlatform.CreateWindowPane(pWindowPos, pWindowSize, pFullScreen) != rcode::ok) return;
+    const __m128i s  = _mm_unpacklo_epi8(_mm_set1_epi32((int)src.n), zero);
+    const __m128i a  = _mm_set1_epi16(src.v.a);
+    const __m128i sa = _mm_mullo_epi16(s, a);
+    const __m128i c  = _mm_set1_epi16(255 - src.v.a);
 
-    pThreadRunning = true;
+    size_t i = 0;
 
-    UpdateViewport();
+    for (; i + 4 <= count; i += 4) {
+      __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
 
-    std::thread thread = std::thread(&pixel::Application::pEngineThread, this);
-    thread.detach();
+      __m128i lo = _mm_add_epi16(_mm_add_epi16(sa, _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), c)), half);
+      __m128i hi = _mm_add_epi16(_mm_add_epi16(sa, _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), c)), half);
 
-    pPlatform.StartSystemEventLoop();
-    pPlatform.ApplicationCleanUp();
-  }
+      lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+      hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
 
-  void Application::pEngineThread() {
-    if (pPlatform.CreateGraphics(pFullScreen, pVsync, pViewPos, pViewSize) == rcode::err) return;
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+    }
 
-    RegisterSprite(pFontSprite);
+    pFillScalar(dst + i, count - i, src);
+  }
 
-    pBuffer = new Pixel[pScreenSize.prod()];
-    for (uint32_t i = 0; i < pScreenSize.prod(); i++) {
-      pBuffer[i] = Pixel();
-    }
+  void Blend::pBufferSSE2(const Pixel* src, Pixel* dst, size_t count) {
+    const __m128i zero   = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+    const __m128i half   = _mm_set1_epi16(128);
+    const __m128i full   = _mm_set1_epi16(255);
 
-    pBufferId = pRenderer.CreateTexture(pScreenSize.x, pScreenSize.y);
-    pRenderer.UpdateTexture(pBufferId, pScreenSize.x, pScreenSize.y, pBuffer);
+    auto blend = [&](__m128i s, __m128i d) {
+      __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF);
+      __m128i x = _mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, _mm_sub_epi16(full, a)));
 
-    pClock1 = std::chrono::system_clock::now();
-    pClock2 = std::chrono::system_clock::now();
+      x = _mm_add_epi16(x, half);
+      return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    };
 
-    if (pOnLaunch) {
-      if (pOnLaunch(*this) != rcode::ok) pThreadRunning = false;
-    }
+    size_t i = 0;
 
-    while (pThreadRunning) {
-      while (pThreadRunning) {
-        pClock2       = std::chrono::system_clock::now();
-        pElapsedTimer = pClock2 - pClock1;
-        pClock1       = pClock2;
-        pElapsedTime  = pElapsedTimer.count();
+    for (; i + 4 <= count; i += 4) {
+      __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
 
-        pFrameTimer += pElapsedTime;
-        pFrameCount++;
+      __m128i lo = blend(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+      __m128i hi = blend(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
 
-        if (pFrameTimer >= 1.0f) {
-          pFrameRate = pFrameCount;
-          pFrameTimer -= 1.0f;
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+    }
 
-          pWindowTittle = pWindowName + " - FPS: " + std::to_string(pFrameRate);
-          pPlatform.SetWindowTitle(pWindowTittle);
+    pBufferScalar(src + i, dst + i, count - i);
+  }
 
-          pFrameCount = 0;
-        }
+  // Streaming stores need aligned addresses, so the pixels before the first aligned one are set one by one
+  void Blend::pClearSSE2(Pixel* dst, size_t count, const Pixel& color, bool stream) {
+    const __m128i c = _mm_set1_epi32((int)color.n);
 
-        for (uint32_t i = 0; i < 3; i++) {
-          pMouseButtons[i].pressed  = false;
-          pMouseButtons[i].released = false;
+    size_t i = 0;
 
-          if (pMouseButtonsNew[i] != pMouseButtonsOld[i]) {
-            if (pMouseButtonsNew[i]) {
-              pMouseButtons[i].pressed = !pMouseButtons[i].held;
-              pMouseButtons[i].held    = true;
+    if (stream) {
+      for (; i < count && ((uintptr_t)(dst + i) & 15); i++) dst[i] = color;
+      for (; i + 4 <= count; i += 4) _mm_stream_si128((__m128i*)(dst + i), c);
 
-            } else {
-              pMouseButtons[i].released = true;
-              pMouseButtons[i].held     = false;
-            }
-          }
+      _mm_sfence();
 
-          pMouseButtonsOld[i] = pMouseButtonsNew[i];
-        }
+    } else {
+      for (; i + 4 <= count; i += 4) _mm_storeu_si128((__m128i*)(dst + i), c);
+    }
 
-        for (uint32_t i = 0; i < 512; i++) {
-          pKeyboardKeys[i].pressed  = false;
-          pKeyboardKeys[i].released = false;
+    pClearScalar(dst + i, count - i, color, false);
+  }
 
-          if (pKeyboardKeysNew[i] != pKeyboardKeysOld[i]) {
-            if (pKeyboardKeysNew[i]) {
-              pKeyboardKeys[i].pressed = !pKeyboardKeys[i].held;
-              pKeyboardKeys[i].held    = true;
+  // The distances above and below color are taken with saturating subtractions, one of which is always zero, scaled
+  // in 16 bits and added and subtracted back, which is the scalar kernel one channel at a time
+  void Blend::pFadeSSE2(Pixel* dst, size_t count, const Pixel& color, uint8_t keep) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c    = _mm_set1_epi32((int)color.n);
+    const __m128i k    = _mm_set1_epi16(keep);
+
+    auto scale = [&](__m128i x) {
+      __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(x, zero), k), 8);
+      __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(x, zero), k), 8);
+      return _mm_packus_epi16(lo, hi);
+    };
 
-            } else {
-              pKeyboardKeys[i].released = true;
-              pKeyboardKeys[i].held     = false;
-            }
-          }
+    size_t i = 0;
 
-          pKeyboardKeysOld[i] = pKeyboardKeysNew[i];
-        }
+    for (; i + 4 <= count; i += 4) {
+      __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
 
-        if (pClearBuffer) {
-          for (uint64_t i = 0; i < pScreenSize.prod(); i++) {
-            pBuffer[i].n = pBufferColor.n;
-          }
-        }
+      __m128i above = scale(_mm_subs_epu8(d, c));
+      __m128i below = scale(_mm_subs_epu8(c, d));
 
-        if (pOnUpdate) {
-          if (pOnUpdate(*this) != rcode::ok) pThreadRunning = false;
-        }
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_subs_epu8(_mm_adds_epu8(c, above), below));
+    }
 
-        pRenderer.UpdateViewport(pViewPos, pViewSize);
-        pRenderer.ClearBuffer(Black, true);
-        pRenderer.PrepareDrawing();
+    pFadeScalar(dst + i, count - i, color, keep);
+  }
 
-        pRenderer.ApplyTexture(pBufferId);
-        pRenderer.UpdateTexture(pBufferId, pScreenSize.x, pScreenSize.y, pBuffer);
-        pRenderer.DrawLayerQuad();
+  void Blend::pModulateSSE2(const Pixel* src, Pixel* dst, size_t count, const Pixel& tint) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i t    = _mm_unpacklo_epi8(_mm_set1_epi32((int)tint.n), zero);
 
-        for (auto& s : pSpritesPending) {
-          pRenderer.ApplyTexture(s.pSprite->pBufferId);
-          pRenderer.DrawDecalQuad(s);
-        }
+    auto modulate = [&](__m128i s) {
+      __m128i x = _mm_add_epi16(_mm_mullo_epi16(s, t), half);
+      return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    };
 
-        pSpritesPending.clear();
-        pRenderer.DisplayFrame();
+    size_t i = 0;
 
-        if (pWantsToClose) {
-          pThreadRunning = false;
-          pWantsToClose  = false;
-        }
-      }
+    for (; i + 4 <= count; i += 4) {
+      __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
 
-      if (pOnClose) {
-        if (pOnClose(*this) != rcode::ok) pThreadRunning = true;
-      }
-    }
+      __m128i lo = modulate(_mm_unpacklo_epi8(s, zero));
+      __m128i hi = modulate(_mm_unpackhi_epi8(s, zero));
 
-    delete[] pBuffer;
-    pRenderer.DeleteTexture(pBufferId);
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
 
-    pHasBeenClosed = true;
+    pModulateScalar(src + i, dst + i, count - i, tint);
   }
 
-  rcode Application::Launch(bool background) {
-    if (pHasBeenClosed) return rcode::abort;
+  void Blend::pMaskSSE2(const Pixel* src, Pixel* dst, size_t count) {
+    const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
 
-    std::thread thread = std::thread(&pixel::Application::pStartThread, this);
+    size_t i = 0;
 
-    if (background) {
-      thread.detach();
+    for (; i + 4 <= count; i += 4) {
+      __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+      __m128i m = _mm_cmpeq_epi32(_mm_and_si128(s, alpha), alpha);
 
-    } else {
-      thread.join();
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_and_si128(m, s), _mm_andnot_si128(m, d)));
     }
 
-    return rcode::ok;
+    pMaskScalar(src + i, dst + i, count - i);
   }
 
-  void Application::pCreateFont() {
-    std::string font_base64;
-
-    // Base64 encoded 1805x32 monochromatic ascii font sheet. Using "Source Code Pro 32" as font
-
-    font_base64 += "AAAAAAAAAAAAAGAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAADAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAcAAAAAAAAAAAAAAAAAAAAAAMAAAAAAAAAAAABCAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAADAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA4D9wAID/AA";
-    font_base64 += "AAAAAAOAAAAMABAAAAAIABAAAA/AAAAAcAABwA4AAOAPgPAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAwAA6AAQAAAAAAAOAA8HAAAACAAQAAAAAAgAMAwAEOAAAAAAAAAAAAAAAAAABwAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA4A8AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAPwHDADwHwAAAAAAAA4AAAA4AAAAAAAwAAAA4D8AAO";
-    font_base64 += "AAAMADAB7AAQD/AQAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAADwB8AB8AcAAAAAAAAcAB4Og";
-    font_base64 += "GEAMAAeAIAPAHAAAByAAwAAAAAAAAAAAAAAAAAABsAHADgA+AHADwDAAfw/AH7A/x/ADwA/AAAAAAAAAAAA";
-    font_base64 += "AAAAAP8DAAAAHAD/AwA/wH8A/H/g/wPwAwzg4P8D/h84wIEDAA94cIAD+AD8DwA+AP8DgB/w/x8GcBgAdwB";
-    font_base64 += "wDuA4AA7/P4ABgAEAAAMADgAAAIADAAAABwAAAAAABgAAABwEAAAcAAB4AMADOAAAOAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAwAAAAAAAAAAAAAAAAAAAAABgA4AMABAAAAAACAA8DDATAMgB/gDxj4AwAOAMAB4AAAAAAAAAAAA";
-    font_base64 += "AAAAAAA4AD+A/gHwP8A/gcAPID/B/A/+P8D/gPwDwAAAAAAAIAAAAACAODwAPADgAfg/wH4H/g/gP8P/H+A";
-    font_base64 += "/4EBHPx/wP8DBzxwAOABDw5wwH+A/wfwH+D/AfwP/v/DAA4HYBwAjgMODuDg/wcwAHAAAGAAwAMAAADgAAA";
-    font_base64 += "A4AAAAAAAwAAAAMABAACAAwAADgBwAAcAAAcAAAAAAAAAAAAAAAAAAAAAAIABAAAAAAAAAAAAAAAAAAAA4A";
-    font_base64 += "AABwAwAAAAAAAAcAB4OACGAPwPhoGDYwDAAQAYADgAAAAAAAAAAAAAAAAAAAzg8QD/ADwc4OEBgAcwAAAfB";
-    font_base64 += "wAw4OAAhwcAAAAAAAAYAADAAQAAHID/ANgAHHyAjweDDzAAgAMA+HwwgANwAABw4IADDgA84MEDDnwecOAB";
-    font_base64 += "nwcceMDnA+AAGMDhAI4DwGHAwQEcAGAABgAMAAAMAGwAAAAACAAAABwAAAAAABgAAAAYAAAAcAAAAAAAAOA";
-    font_base64 += "AAOAAAAAAAAAAAAAAAAAAAAAAAAAwAAAAAAAAAAAAAAAAAAAAAAwA4AAABgAAAAAAAA4ADwdAEMDDw2A4MA";
-    font_base64 += "wAOACAAQAGACAAAAMAAAAAAAAAAIABHBgAHIABBwxwANgABgBwAAAABww4cOAAAAAAAADAAwAAeAAAAAM4O";
-    font_base64 += "AAbgAMOeEBgwAMGAHAAgAMEBnAADgAADhw4wAGADT54wMEDBw5w8MCBAxw8YAAcAAM4HMBxABgcHHCAAQAO";
-    font_base64 += "wACAAwCAAYANAAAAAAAAAIADAAAAAAADAAAAAwAAAA4AAAAAAAAcAAAcAAAAAAAAAAAAAAAAAAAAAAAABgA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAIABABwAwAAAAAAAAMAB4OAACAM4IBgMA4YDAAcAOADAAQAEAGAAAAAAAAAAAAA4wA";
-    font_base64 += "EHgAMAwAAADoAbwAAADgAAcMABBgc4AA4AAAAAHAAAADwAAGCAAwxgB3DAgQcADHDAAAAOADgAwAAOwAEAw";
-    font_base64 += "IGDAzgAsMEGHzg44MABDg44cICDAwCAA2AABwcYDoADhwEMOADgABgAYAAAMAA4AwAAAAAAAABwAAAAAABg";
-    font_base64 += "AAAAYAAAAMABAAAAAACAAwCAAwAAAAAAAAAAAAAAAAAAAAAAwAAAAAAAAAAAAAAAAAAAAAAwAIADABgAAAA";
-    font_base64 += "AAAA4ABgcgGEAAwCDMcAwAOAAAAMAMACAAAAMAAAAAAAAAAAAAxjAAHAAADgAwAE4AxgA4AAAAAY4wOAABu";
-    font_base64 += "ADAB4A4AEAAAAPAAAOOIAB7gAOMHAAgAEcGADAAQAHABjAATgAADhwOAAHAD7YYAOHAzg4gOEADg5wcAAAc";
-    font_base64 += "AAM4OCAw+Fw4DiAAwMADAADAAwAAAYAYwAAAAAAAPwAzgcAfgB8DMAP4P8H8H84PsD/AP4HcIADcADmcGD4";
-    font_base64 += "APABGB8APgYYfoA/wP8fDmAwAOYA4DjAYAAM/n8ADgBwAAADAAAAAAAABwCDA/5/YABgMAMYBwAcAGAAAA4";
-    font_base64 += "AMACAAQAAAAAAAAAAYAADOAAOAAAHADiAYwADABwAAGAABhgcwAB8AOADAA6A/w+ABwDAAAMwwBjAAQYGAD";
-    font_base64 += "CAAwMAOABwAAADOAAHAAAHjgPgAMCPH+zgcAAHBzAcwMEBDg4AAA6AARwccDgcDjgDYHAAwAFgAIADAMAAY";
-    font_base64 += "BwAAAAAAOB/wP0D8D/AvwH+B/z/gP8P8w/4H8D/AA44AA7Avh/MP4D/APMP4N8A4w/4H/j/wwEMDuAYHBwG";
-    font_base64 += "HByAwf8PwAEADgBgAAAAAAAAwABgMMD/DxwADCMAdwCAAwAOAMABCIYAMAAAAAAAAAAAAA5wAAfAAQBgAIA";
-    font_base64 += "DMAxgAIABAAAOwIGDAziADwB8APAA8P8B4AEAHHAABBgHOODgAAAGYGAAAAcADgBgAAfgAADgwHkAHAC4sY";
-    font_base64 += "MZHA7A4ACGAzA4wIEDAMABMIADAwaHxwF3ABwGABwADABgAAAYAAYDAAAAAAAfDvjxAB8PPD7g4QEwADgcY";
-    font_base64 += "McDgAMAHMCBA8ABeL6HHQ94PODHAx4fYJ+BgwdgADiAgQEcg4PBwQEDOADgADgAwAEADAAAAAAAABgADAbA";
-    font_base64 += "MAAPAGMAwAcAYADAAAAwAM8eAAYAAAAAAAAAAMAAjuMAOAAADgA8AIcB7AcwPgDAAHA4cAAH4AGADwAHAAA";
-    font_base64 += "AAHAAwAEGgIDjAAcPHADAABwMAOAAwAEADOAAHAAAHDgHgAMAN3Ywh8MAOBzgMAAOBzjwAQA4AAZw4MDA8D";
-    font_base64 += "jABwDjAIABgAEADAAAA8BgAAAAAABAgAMPHHCAwAEHHjAABgADBzxwAHAAgAM4OAA4AMfj8MCBAw48cOCAA";
-    font_base64 += "2wAOEAADAAHMHCA4fAwcBjgAAMADgAHADgAgAHAAQEAAAADgMEAGAbAB+AHAHgAAAwAGAAABsD/Af8fAADA";
-    font_base64 += "/wcAAAAcwHEcAAcAwAH4A3AwgP8D9x8AHAD8AwzwAAAA4ABwAAAAAAAcABzAgB8wGOB/gAMAGICD/wP8Pxg";
-    font_base64 += "AgP8fgAMAgAP3AXAA4OwOxnAYAIcDHAbA4cAD/AEAB8AADhwcGBsD8ADgDAA4ADAAgAMAYAAcHAAAAAAAAG";
-    font_base64 += "DgAAcHADjAwAEOwABwwIADHAAOAHAAhwMAB+AwHA5wcICDAxwcYIAHAAcAgAHgAAYOOBwaBowDGHAA4ADgA";
-    font_base64 += "AAHADAA/DAAAABgAAAAAEMA8AMgQIAHGAAAAAMAwADAD+D/AwAA+P8AAACAATieA+AAABwAfwAHBjDw4AcH";
-    font_base64 += "gAOAP4CHHwAAAAAADgAAAAAAA8ABGHwDBgf8P3AAAANw8H+A/wcDf/D/A3AAAHDgdwAOAJzNwTgOA+Bw4ME";
-    font_base64 += "AOPw/AP4A4AAYwAGDAWdjAA4A2AGAAwAGAGAAAAyAAQMAAAAAAAAMHODgAIADGBiAARgADhhwgAPAAQAO4D";
-    font_base64 += "gA4AAMhsMBDgdwcIDDAQxwAOABADAAHMCAAYNj44A7AAcGAA4ADADgAAAOwDgGAAAADAAAACAIAPABAD/4g";
-    font_base64 += "QMAAGAAADgA8AAAAwAAAAAAAAAAMADHcQAcAMABADxgwAAAHDzAATAAHB/gvwMAAAAAwAMAAAAAeAAYAMNh";
-    font_base64 += "4OCAAw4OAGAADgYAcADg4A8GcAAOAAAOfA7AAYCzORjGYQAc/h8YAIf/AwB+ABwAAzjgMODsDOADAB8AOAD";
-    font_base64 += "AAAAcAIABMGAAAAAAAAD4gQMcDABwAIMDMAADwAEDDnAAOADAAZwDAByAwXA4wOEADg5wOIABBgD4AAAGgA";
-    font_base64 += "MYcHBgbBzgA+DAAOAA+AAAHACADxh+AAAAgAEAAID/DwB4ADGOczAAAAAMAAAHABsAYAAAAAAAAAAAAAfgA";
-    font_base64 += "A6AAwA4AAAODhgAAIMDOAAHwIEH8HEAAAAAAOABAAAAgAMAA2AcDBwYcIDDAQAMwMEAAA4AHIDBAA7AAQDA";
-    font_base64 += "gYcDOABwHAfDOQyAw/8AA+BwOAAAD4ADYAAHHAecnQFsAMABAAcAGAAAAwAwAAAAAAAAAADwP3AAgwEADmD";
-    font_base64 += "w/wdgADBwwAEOAAcAOID7AIADMBgOBzgcgMEBDAcwwAAA/gHAAHAAAwwOjI0BOAAYHAAOAB8AgAMA4AEABw";
-    font_base64 += "AAAAAAAADw/wEADjCGMRwHAACAAQBgAHAGAAwAAAAAAAAAAGAAHMABcACAAwCA4f8fAOBgAAfgABjAAQAGA";
-    font_base64 += "AAAAAB4APx/ADwAAACMgYH/Bw5gOACAARgYAMABgAMwGMABOAAAOPBwAAcAjuNgMIcDMDgA4AAMDgcAgANw";
-    font_base64 += "AAzgAOOAOzvAHQA4AHAAAAMAYAAABgAAAAAAAACADwYOYDAAwAEM/v8ADAAOBzjAAeAAAAfwOwBwAAbD4QC";
-    font_base64 += "HAzA4gOEABhgAAP4AGAAOYIDDgLMzgA8AhwHgAQAHAHAAAAcAAAAAAAAAAAAAGAYAgAFHMAdnAAAAMAAADA";
-    font_base64 += "DGAYABAAAAAAAAAAAOAAMYAA4AOAAAMPz/AwAcDMAAHIADOADAAAAAAAAAPID/D8ABAACAMTD4/8ABDA4AM";
-    font_base64 += "IADAwA4AHAABgM4AAcAAAcOHOAAwHEcDO5wAAcHABzAwcEBAHAADoABHGAMYGMHHAcABwAHAGAAABwAwAAA";
-    font_base64 += "AAAAAAAAOMDAAQ4GADiAwQEAgAGAfwAHOAAcAOAAPg4ADsBgOBzgcAAHBzgcwAADAAA8AAPAAQxgHHBnBrA";
-    font_base64 += "BwDAAHADAAAAOAGAAAAAAAAAAAAAAAMMAADBwDObADwAAAAYAgAFgMAAwAAAAAAAAAADAAGAAA8ABgAMAAA";
-    font_base64 += "4ADACAgwMcgAFwAAcAHAAAAAAAAA8AAAAeAAAAMA4HBxg4gMEBAAZwYAAABwAcwGAAB+AAAODAgQMcADiAg";
-    font_base64 += "4EdDuDgAIADODg4AAAOwAFwgAGcAWz8gOMA4ADgAAAMAAADABgAAAAAAAAAAAMYOMDBAQAHMDgAADAA2APg";
-    font_base64 += "AAeAAwAcwIMBwAEYDIcDHA7g4ACHAxhgAAAADmAAOIABjAFu7AB3ADgHwAEAOADAAQAMAAAAAAAAHAAAAGA";
-    font_base64 += "YwAAHh8Ec8AAAAMAAADAABAQABgA4AAAAAB4AGAAccAA4ADgAAMAAgAEAOHCAAzAADuAAgAHgAQAHAIAHAA";
-    font_base64 += "DgAABwAIa/YAAHBzh4AMAABwwA4ACAAxgM4AAcAAIMOOCAAwAHcDDwgwMOHADgAAMHDgjAATgADjgAO4CND";
-    font_base64 += "zg4ABwADgCAAQBgAAADAAAAAAAAAGAAAwc4OADgAAYOAAAGgAMAHOAAcACAAzhwADgAg+FwgIMBHBzgcAAD";
-    font_base64 += "DAAAwAEMAAY4gDOAjR1wHABmABwAAAcAOACAAQAAAAAAwAcAAAAMA3jwYGAYBz4AAAA4AAAHAAAAAACADwA";
-    font_base64 += "AAOADgAMABwYAB8ADgAMcADBgAAccOAAHgAEcADgAPgDwAQDgAAAADgAAD8DgEQ7g4AAHHjAY8IABABwA4A";
-    font_base64 += "CDARyAA+DAAQc4cADgAA4GfPDAgQMAHHDggAMHOAAHwAMHYAPw4QEDBoAD4AAAMAAAHABgAAAAAAAAAAAMc";
-    font_base64 += "OCAAw4QOODAAwDAAHAAgAMcAA4AcAAHHAAHYDAcDnBwwIEDDhxwgAEAATiAA8CBB2AHsPEBBgfADsABAOAA";
-    font_base64 += "AAcAMAAAAAAAAPgAAACAYQD+DwYM4+EfAAAABgDgAAAAAAAA8AEAAAB8ADAA4PEA4AA8APDhAQAGPHgAhwf";
-    font_base64 += "gAPDggcMDwAcAPgAAEAAAQAAA4AEYAMABGBx4gI8Hgw8wAIADAHx8MIADcAA8PuAABw4AHMDBgA88HnAAAI";
-    font_base64 += "8HHHDg4wPgAPB5AHwAHjxwwAFwAAwAAAYAAAMADAAAAAAAAACAhw98PICHBx8f8OAAGAAeAHCAA8ABAA7gA";
-    font_base64 += "AfgIQyGwwEOPB7w8YCPDzAA8IED8CB43AB8ADY84OAA8AAcAAAcAOAAAAYAAAAAAAAfAAAAEAQAf4AAP/iP";
-    font_base64 += "AwAAwAAADAAAAAAAAH4AAACADwAGAPgP8P/D/x/4HwDAAP8HwH8AHAD8H/A/APgAwA8AAAAAAAAAADwABgA";
-    font_base64 += "YAIf/B+B/4P8A/j9wAAD+BwZw8P8B/wMcwMH/hwM4GOAB/wEOAMB/gAMc+D8AHAD8BwAPwIMHBnAADsD/H8";
-    font_base64 += "AAAOAAgAEAAAAAAAAA4L+B/QPgf8B/A/wfAAOA/wcOcAA4AMABHOAA+IfBcDjAAf8B/g/gvwEGAPg/APwH/";
-    font_base64 += "hkAD8CDBw44AB7A/x+AAQAcAMAAAAAAAADAAQAAAIIAAAMAwAN8YAAAADgAwAEAAAAAAIAPAAAA4ADgAAB8";
-    font_base64 += "AP5/+P8D/AAAGAA/AOADgAMA/gD4AQAOAPABAAAAAAAAAAAHwACAA+DwPwDwA/wHwP8HDgAAP8AADv4/gB+";
-    font_base64 += "AAzj4/3AABwM8gA/AAQDgB3CAA/wBgAMAfgDgAHjw4AAOwAH4/wMYAAAYADAAAAAAAAAAAPgxMD4A8APgYw";
-    font_base64 += "D+AGAA4P/DAQ4ABwA4gAM4AHwwGA4HOIAPwPkA8DHAAAD8AQB+gA8D4ABw8OAADsAD+P8DMACAAwAYAAAAA";
-    font_base64 += "AAAAAAAAAAAAGAAAAAAAAAAAAAGABgAAAAAAADAAQAAAAAADAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAA4AAAAAAAAAAAAADAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAOAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAwAAAwAGAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAdwAAAAAAAABwAAAAAAAAAAAA";
-    font_base64 += "AAADgAAAAGAAAAAAAAAAAAAAAAAAAAAAAwAAAAAAYAcAAAAwAAAAAAAAAAAAAAAAAMAAAAAAAAAACAAYADA";
-    font_base64 += "AAAAAAAGAAAAAAAwAEAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAwAAAAAAAAAAAAAOEAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA4AAAAAAAAAAAAAAAAAAAAAAAAAAAAAYAAA4ADAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAGAADgAAAAAA4AAAAAAAAAAAAAAAAAAHAADAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AABwAAAMAAAA4AYAAAAAAAAAAAAAAAAACAAQAAAAAAAAAAcAA4AAAAAAAAAAMAAAAAABgAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAYAAAAAAAAAAAAACABwMAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAIAHAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAwAABgAGAAAAP7/AAAAAAAAAAAAAAAAAAAAAAAOwAE";
-    font_base64 += "AAAAAABwAAAAAAAAAAAAAAADgAAAAGAAAAAAAAAAAAAAAAAAAAAAAYAAAAAA4AMABAA4AAAAAAAAAAAAAAA";
-    font_base64 += "AAMAAAAAAAAAAAAByAAwAAAAAAADAAAAAAAAADAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAYAAAAAA";
-    font_base64 += "AAAAAAA4H8AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAADgDwAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAID/AAAD/gMAAMD/HwAAAAAAAAAAAAAAAAAAAADAATgAAAAAAMABAAAAAAAAAAAAAAAAHAAAAAM";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAA4AAAAA/gA4AP4AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAHOAAAAAAAAAAHAA";
-    font_base64 += "AAAABwAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAOAAAAAAAAAAAAAAAOABAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA8AEAAAAAAAAAAAAAAAAAAAAAAAAAAADwHwDgwH8AAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAcMADAAAAADA8AAAAAAAAAAAAAAAAgAMAAGAAAAAAAAAAAAAAAAAAAAAAAOAAAAAAgB8";
-    font_base64 += "AB8APAAAAAAAAAAAAAAAAAAAAAAAAAAAAAABAAAIAAAAAAAB4AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAPAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAPwfAAAAAAD+AwAA";
-    font_base64 += "AAAAAAAAAAAAAHAAAAAMAAAAAAAAAAAAAAAAAAAAAMAPAAAAAAAA4AAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAgAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAABAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAD+AAAAAACAHwAAAAAAAAAAAAAAAAAOAACAAQAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAD4AAAAAAAAABwAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
-    font_base64 += "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAIADAAAAAAA=";
-
-    uint8_t font_data[1805 * 32 / 8];
-
-    int8_t b64invs[] = {62, -1, -1, -1, 63, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1,
-                        -1, -1, 0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14, 15, 16, 17,
-                        18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1, -1, 26, 27, 28, 29, 30, 31,
-                        32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51};
-
-    uint32_t i;
-    uint32_t j;
-    uint32_t v;
-
-    for (i = 0, j = 0; i < font_base64.length(); i += 4, j += 3) {
-      v = b64invs[font_base64[i] - 43];
-      v = (v << 6) | b64invs[font_base64[i + 1] - 43];
-
-      v = font_base64[i + 2] == '=' ? v << 6 : (v << 6) | b64invs[font_base64[i + 2] - 43];
-      v = font_base64[i + 3] == '=' ? v << 6 : (v << 6) | b64invs[font_base64[i + 3] - 43];
-
-      font_data[j] = (v >> 16) & 0xFF;
-
-      if (font_base64[i + 2] != '=') {
-        font_data[j + 1] = (v >> 8) & 0xFF;
-      }
-
-      if (font_base64[i + 3] != '=') {
-        font_data[j + 2] = v & 0xFF;
-      }
-    }
-
-    pFontSprite = new Sprite(1805, 32);
-
-    for (uint16_t m = 0; m < 1805 * 32; m++) {
-      pFontSprite->pBuffer[m].n = (font_data[m / 8] & (1 << (m % 8)) ? 0xFFFFFFFF : 0x00000000);
-    }
-  }
+  void Blend::pLerpSSE2(const Pixel* a, const Pixel* b, Pixel* dst, size_t count, uint16_t weight) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i w    = _mm_set1_epi16(weight);
+    const __m128i c    = _mm_set1_epi16(256 - weight);
 
-  void Application::Close() { pWantsToClose = true; }
+    auto lerp = [&](__m128i x, __m128i y) {
+      return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(x, c), _mm_mullo_epi16(y, w)), half), 8);
+    };
 
-  void Application::EnsureClosed() {
-    while (!pHasBeenClosed) {
-    }
-  }
+    size_t i = 0;
 
-  void Application::SetName(const std::string& name) { pWindowName = name; }
+    for (; i + 4 <= count; i += 4) {
+      __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+      __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
 
-  void Application::SetDrawingMode(pixel::DrawingMode mode) { pDrawingMode = mode; }
+      __m128i lo = lerp(_mm_unpacklo_epi8(x, zero), _mm_unpacklo_epi8(y, zero));
+      __m128i hi = lerp(_mm_unpackhi_epi8(x, zero), _mm_unpackhi_epi8(y, zero));
 
-  void Application::RegisterSprite(Sprite* spr) {
-    if (spr->pBufferId != 0xFFFFFFFF) pRenderer.DeleteTexture(spr->pBufferId);
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
 
-    spr->pBufferId = pRenderer.CreateTexture(spr->pSize.x, spr->pSize.y);
-    pRenderer.UpdateTexture(spr->pBufferId, spr);
+    pLerpScalar(a + i, b + i, dst + i, count - i, weight);
   }
 
-  void Application::DrawString(const vu2d& pos, std::string_view text, uint8_t size, const Pixel& color) {
-    vu2d p = pos;
+  // The two pixels a dst pixel is interpolated from are adjacent, so they are read with a single 64 bit load and
+  // widened to 16 bits per channel together. There is no AVX2 version, as gathering the pairs was barely any faster
+  void Blend::pResampleSSE2(const Pixel* src, Pixel* dst, size_t count, const uint32_t* columns, const uint16_t* w) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i full = _mm_set1_epi16(256);
 
-    for (const char& c : text) {
-      if (isascii(c) > 0) {
-        if (c == '\n') {
-          p.y += size;
-          p.x = pos.x;
+    // Both pixels of the pair times their weight, the first in the low half and the second in the high half
+    auto weigh = [&](size_t i) {
+      __m128i pair   = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + columns[i])), zero);
+      __m128i weight = _mm_set1_epi16(w[i]);
 
-          continue;
-        }
+      return _mm_mullo_epi16(pair, _mm_unpacklo_epi64(_mm_sub_epi16(full, weight), weight));
+    };
 
-        DrawPartialSprite(p,
-                          vu2d((c - 32) * 19, 0),
-                          vu2d(19, 32),
-                          pFontSprite,
-                          vf2d((float)size / 32.0f, (float)size / 32.0f),
-                          color);
-        p.x += (float)size * 0.6f;
-      }
+    size_t i = 0;
+
+    for (; i + 2 <= count; i += 2) {
+      __m128i m0 = weigh(i);
+      __m128i m1 = weigh(i + 1);
+      __m128i x  = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi64(m0, m1), _mm_unpackhi_epi64(m0, m1)), half);
+
+      x = _mm_srli_epi16(x, 8);
+      _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(x, x));
     }
+
+    pResampleScalar(src, dst + i, count - i, columns + i, w + i);
   }
 
-  void Application::Draw(const vu2d& pos, const Pixel& pixel) {
-    if (pos.x >= pScreenSize.x) return;
-    if (pos.y >= pScreenSize.y) return;
+  // Doubling and tripling shuffle four pixels at a time, larger factors store each pixel broadcast across a register.
+  // It serves the AVX2 table as well, since scaled rows are built once for several destination rows and writing those
+  // is what takes the time
+  void Blend::pRepeatSSE2(const Pixel* src, Pixel* dst, size_t count, uint32_t times) {
+    size_t i = 0;
 
-    if (pDrawingMode == DrawingMode::FULL_ALPHA) {
-      Pixel d = pBuffer[pos.y * pScreenSize.x + pos.x];
+    if (times == 2) {
+      for (; i + 8 <= count; i += 8, src += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*)src);
 
-      float a = (float)(pixel.v.a / 255.0f);
-      float c = 1.0f - a;
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi32(x, x));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi32(x, x));
+      }
 
-      uint8_t r = a * (float)pixel.v.r + c * (float)d.v.r;
-      uint8_t g = a * (float)pixel.v.g + c * (float)d.v.g;
-      uint8_t b = a * (float)pixel.v.b + c * (float)d.v.b;
+    } else if (times == 3) {
+      for (; i + 12 <= count; i += 12, src += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*)src);
 
-      pBuffer[pos.y * pScreenSize.x + pos.x].v = {r, g, b, 255};
-      // pBuffer[pos.y * pScreenSize.x + pos.x].n = (uint8_t)r | ((uint8_t)g << 8) | ((uint8_t)b << 16) | (255 << 24);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 0, 0)));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 2, 1, 1)));
+        _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 2)));
+      }
 
-    } else if (pDrawingMode == DrawingMode::NO_ALPHA) {
-      pBuffer[pos.y * pScreenSize.x + pos.x] = pixel;
+    } else if (times >= 4) {
+      for (; i + times <= count; i += times, src++) {
+        __m128i x = _mm_set1_epi32((int)src->n);
+        size_t  j = 0;
 
-    } else if (pixel.v.a == 255) {
-      pBuffer[pos.y * pScreenSize.x + pos.x] = pixel;
+        for (; j + 4 <= times; j += 4) _mm_storeu_si128((__m128i*)(dst + i + j), x);
+        for (; j < times; j++) dst[i + j] = *src;
+      }
     }
+
+    pRepeatScalar(src, dst + i, count - i, times);
   }
 
-  void Application::DrawLine(const vu2d& pos1, const vu2d& pos2, const Pixel& pixel) {
-    int32_t x, y, dx, dy, dx1, dy1, px, py, xe, ye, i;
-    dx = pos2.x - pos1.x;
-    dy = pos2.y - pos1.y;
+  // Every AVX2 kernel zeroes the upper halves of the vector registers before handing its tail to the SSE2 one. The
+  // compiler turns that call into a jump and skips doing it itself, and leaving them dirty slows down every SSE
+  // instruction that follows, including the scalar floating point code of the caller
+  __attribute__((target("avx2"))) void Blend::pFillAVX2(Pixel* dst, size_t count, const Pixel& src) {
+    const __m256i zero   = _mm256_setzero_si256();
+    const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+    const __m256i half   = _mm256_set1_epi16(128);
 
-    if (dx == 0) {
-      if (pos2.y < pos1.y)
-        for (y = pos2.y; y <= (int32_t)pos1.y; y++) Draw(vu2d(pos2.x, y), pixel);
-      else
-        for (y = pos1.y; y <= (int32_t)pos2.y; y++) Draw(vu2d(pos1.x, y), pixel);
+    const __m256i s  = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)src.n), zero);
+    const __m256i a  = _mm256_set1_epi16(src.v.a);
+    const __m256i sa = _mm256_mullo_epi16(s, a);
+    const __m256i c  = _mm256_set1_epi16(255 - src.v.a);
 
-      return;
-    }
+    size_t i = 0;
 
-    if (dy == 0) {
-      if (pos2.x < pos1.x)
-        for (x = pos2.x; x <= (int32_t)pos1.x; x++) Draw(vu2d(x, pos2.y), pixel);
-      for (x = pos1.x; x <= (int32_t)pos2.x; x++) Draw(vu2d(x, pos1.y), pixel);
+    for (; i + 8 <= count; i += 8) {
+      __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
 
-      return;
-    }
+      __m256i lo = _mm256_add_epi16(_mm256_add_epi16(sa, _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), c)), half);
+      __m256i hi = _mm256_add_epi16(_mm256_add_epi16(sa, _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), c)), half);
 
-    dx1 = std::abs(dx);
-    dy1 = std::abs(dy);
-    px  = 2 * dy1 - dx1;
-    py  = 2 * dx1 - dy1;
+      lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+      hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
 
-    if (dy1 <= dx1) {
-      if (dx >= 0) {
-        x  = pos1.x;
-        y  = pos1.y;
-        xe = pos2.x;
-      } else {
-        x  = pos2.x;
-        y  = pos2.y;
-        xe = pos1.x;
-      }
+      _mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(_mm256_packus_epi16(lo, hi), opaque));
+    }
 
-      Draw(vu2d(x, y), pixel);
+    _mm256_zeroupper();
+    pFillSSE2(dst + i, count - i, src);
+  }
 
-      for (i = 0; x < xe; i++) {
-        x = x + 1;
+  __attribute__((target("avx2"))) void Blend::pBufferAVX2(const Pixel* src, Pixel* dst, size_t count) {
+    const __m256i zero   = _mm256_setzero_si256();
+    const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+    const __m256i half   = _mm256_set1_epi16(128);
+    const __m256i full   = _mm256_set1_epi16(255);
 
-        if (px < 0)
-          px = px + 2 * dy1;
-        else {
-          if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0))
-            y = y + 1;
-          else
-            y = y - 1;
-          px = px + 2 * (dy1 - dx1);
-        }
+    size_t i = 0;
 
-        Draw(vu2d(x, y), pixel);
-      }
+    for (; i + 8 <= count; i += 8) {
+      __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+      __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
 
-    } else {
-      if (dy >= 0) {
-        x  = pos1.x;
-        y  = pos1.y;
-        ye = pos2.y;
-      } else {
-        x  = pos2.x;
-        y  = pos2.y;
-        ye = pos1.y;
-      }
+      __m256i slo = _mm256_unpacklo_epi8(s, zero);
+      __m256i shi = _mm256_unpackhi_epi8(s, zero);
+      __m256i alo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(slo, 0xFF), 0xFF);
+      __m256i ahi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(shi, 0xFF), 0xFF);
 
-      Draw(vu2d(x, y), pixel);
+      __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(slo, alo),
+                                    _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), _mm256_sub_epi16(full, alo)));
+      __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(shi, ahi),
+                                    _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), _mm256_sub_epi16(full, ahi)));
 
-      for (i = 0; y < ye; i++) {
-        y = y + 1;
+      lo = _mm256_add_epi16(lo, half);
+      hi = _mm256_add_epi16(hi, half);
 
-        if (py <= 0) {
-          py = py + 2 * dx1;
-        } else {
-          if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0))
-            x = x + 1;
-          else
-            x = x - 1;
-          py = py + 2 * (dx1 - dy1);
-        }
+      lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+      hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
 
-        Draw(vu2d(x, y), pixel);
-      }
+      _mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(_mm256_packus_epi16(lo, hi), opaque));
     }
+
+    _mm256_zeroupper();
+    pBufferSSE2(src + i, dst + i, count - i);
   }
 
-  void Application::DrawCircle(const vu2d& pos, uint32_t radius, const Pixel& pixel) {
-    uint32_t x0 = 0;
-    uint32_t y0 = radius;
-    int      d  = 3 - 2 * radius;
+  __attribute__((target("avx2"))) void Blend::pClearAVX2(Pixel* dst, size_t count, const Pixel& color, bool stream) {
+    const __m256i c = _mm256_set1_epi32((int)color.n);
 
-    if (!radius) return;
+    size_t i = 0;
 
-    while (y0 >= x0) {
-      Draw(vu2d(pos.x + x0, pos.y - y0), pixel);
-      Draw(vu2d(pos.x + y0, pos.y - x0), pixel);
-      Draw(vu2d(pos.x + y0, pos.y + x0), pixel);
-      Draw(vu2d(pos.x + x0, pos.y + y0), pixel);
-      Draw(vu2d(pos.x - x0, pos.y + y0), pixel);
-      Draw(vu2d(pos.x - y0, pos.y + x0), pixel);
-      Draw(vu2d(pos.x - y0, pos.y - x0), pixel);
-      Draw(vu2d(pos.x - x0, pos.y - y0), pixel);
+    if (stream) {
+      for (; i < count && ((uintptr_t)(dst + i) & 31); i++) dst[i] = color;
+      for (; i + 8 <= count; i += 8) _mm256_stream_si256((__m256i*)(dst + i), c);
 
-      if (d < 0)
-        d += 4 * x0++ + 6;
-      else
-        d += 4 * (x0++ - y0--) + 10;
+      _mm_sfence();
+
+    } else {
+      for (; i + 8 <= count; i += 8) _mm256_storeu_si256((__m256i*)(dst + i), c);
     }
-  }
 
-  void Application::FillCircle(const vu2d& pos, uint32_t radius, const Pixel& pixel) {
-    int x0 = 0;
-    int y0 = radius;
-    int d  = 3 - 2 * radius;
+    pClearScalar(dst + i, count - i, color, false);
+  }
 
-    if (!radius) return;
+  __attribute__((target("avx2"))) void Blend::pFadeAVX2(Pixel* dst, size_t count, const Pixel& color, uint8_t keep) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i c    = _mm256_set1_epi32((int)color.n);
+    const __m256i k    = _mm256_set1_epi16(keep);
 
-    auto scanline = [&](int sx, int ex, int ny) {
-      for (int i = sx; i <= ex; i++) Draw(vu2d(i, ny), pixel);
+    auto scale = [&](__m256i x) __attribute__((target("avx2"))) {
+      __m256i lo = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(x, zero), k), 8);
+      __m256i hi = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(x, zero), k), 8);
+      return _mm256_packus_epi16(lo, hi);
     };
 
-    while (y0 >= x0) {
-      scanline(pos.x - x0, pos.x + x0, pos.y - y0);
-      scanline(pos.x - y0, pos.x + y0, pos.y - x0);
-      scanline(pos.x - x0, pos.x + x0, pos.y + y0);
-      scanline(pos.x - y0, pos.x + y0, pos.y + x0);
+    size_t i = 0;
 
-      if (d < 0)
-        d += 4 * x0++ + 6;
-      else
-        d += 4 * (x0++ - y0--) + 10;
-    }
-  }
+    for (; i + 8 <= count; i += 8) {
+      __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
 
-  void Application::DrawRect(const vu2d& pos1, const vu2d& pos2, const Pixel& pixel) {
-    DrawLine(vu2d(pos1.x, pos1.y), vu2d(pos1.y, pos2.x), pixel);
-    DrawLine(vu2d(pos1.y, pos2.x), vu2d(pos2.x, pos2.y), pixel);
-    DrawLine(vu2d(pos2.x, pos2.y), vu2d(pos2.y, pos1.x), pixel);
-    DrawLine(vu2d(pos2.y, pos1.x), vu2d(pos1.x, pos1.y), pixel);
-  }
+      __m256i above = scale(_mm256_subs_epu8(d, c));
+      __m256i below = scale(_mm256_subs_epu8(c, d));
 
-  void Application::FillRect(const vu2d& pos1, const vu2d& pos2, const Pixel& pixel) {
-    for (uint32_t x = std::min(pos1.x, pos2.x); x <= std::max(pos1.x, pos2.x); x++) {
-      for (uint32_t y = std::min(pos1.y, pos2.y); y <= std::max(pos1.y, pos2.y); y++) {
-        Draw(vu2d(x, y), pixel);
-      }
+      _mm256_storeu_si256((__m256i*)(dst + i), _mm256_subs_epu8(_mm256_adds_epu8(c, above), below));
     }
-  }
 
-  void Application::DrawTriangle(const vu2d& pos1, const vu2d& pos2, const vu2d& pos3, const Pixel& pixel) {
-    DrawLine(vu2d(pos1.x, pos1.y), vu2d(pos2.x, pos2.y), pixel);
-    DrawLine(vu2d(pos2.x, pos2.y), vu2d(pos3.x, pos3.y), pixel);
-    DrawLine(vu2d(pos3.x, pos3.y), vu2d(pos1.x, pos1.y), pixel);
+    _mm256_zeroupper();
+    pFadeSSE2(dst + i, count - i, color, keep);
   }
 
-  void Application::FillTriangle(const vu2d& pos1, const vu2d& pos2, const vu2d& pos3, const Pixel& pixel) {
-    auto drawline = [&](int32_t sx, int32_t ex, int32_t ny) {
-      for (int32_t i = sx; i <= ex; i++) Draw(vu2d(i, ny), pixel);
+  __attribute__((target("avx2"))) void Blend::pModulateAVX2(const Pixel* src,
+                                                            Pixel*       dst,
+                                                            size_t       count,
+                                                            const Pixel& tint) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i half = _mm256_set1_epi16(128);
+    const __m256i t    = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)tint.n), zero);
+
+    auto modulate = [&](__m256i s) __attribute__((target("avx2"))) {
+      __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(s, t), half);
+      return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
     };
 
-    vu2d p1 = pos1;
-    vu2d p2 = pos2;
-    vu2d p3 = pos3;
+    size_t i = 0;
 
-    int32_t t1x, t2x, y, minx, maxx, t1xp, t2xp;
-    int32_t signx1, signx2, dx1, dy1, dx2, dy2;
-    int32_t e1, e2;
+    for (; i + 8 <= count; i += 8) {
+      __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
 
-    bool changed1 = false;
-    bool changed2 = false;
+      __m256i lo = modulate(_mm256_unpacklo_epi8(s, zero));
+      __m256i hi = modulate(_mm256_unpackhi_epi8(s, zero));
 
-    if (p1.y > p2.y) {
-      std::swap(p1.y, p2.y);
-      std::swap(p1.x, p2.x);
-    }
-    if (p1.y > p3.y) {
-      std::swap(p1.y, p3.y);
-      std::swap(p1.x, p3.x);
-    }
-    if (p2.y > p3.y) {
-      std::swap(p2.y, p3.y);
-      std::swap(p2.x, p3.x);
+      _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(lo, hi));
     }
 
-    t1x = t2x = p1.x;
-    y         = p1.y;
-    dx1       = (int)(p2.x - p1.x);
-    if (dx1 < 0) {
-      dx1    = -dx1;
-      signx1 = -1;
-    } else
-      signx1 = 1;
-    dy1 = (int)(p2.y - p1.y);
+    _mm256_zeroupper();
+    pModulateSSE2(src + i, dst + i, count - i, tint);
+  }
 
-    dx2 = (int)(p3.x - p1.x);
-    if (dx2 < 0) {
-      dx2    = -dx2;
-      signx2 = -1;
-    } else
-      signx2 = 1;
-    dy2 = (int)(p3.y - p1.y);
+  __attribute__((target("avx2"))) void Blend::pMaskAVX2(const Pixel* src, Pixel* dst, size_t count) {
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
 
-    if (dy1 > dx1) {
-      std::swap(dx1, dy1);
-      changed1 = true;
-    }
-    if (dy2 > dx2) {
-      std::swap(dy2, dx2);
-      changed2 = true;
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+      __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+      __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+      __m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(s, alpha), alpha);
+
+      _mm256_storeu_si256((__m256i*)(dst + i), _mm256_blendv_epi8(d, s, m));
     }
 
-    e2 = (int)(dx2 >> 1);
+    _mm256_zeroupper();
+    pMaskSSE2(src + i, dst + i, count - i);
+  }
 
-    if (p1.y == p2.y) goto next;
-    e1 = (int)(dx1 >> 1);
+  __attribute__((target("avx2"))) void Blend::pLerpAVX2(const Pixel* a,
+                                                        const Pixel* b,
+                                                        Pixel*       dst,
+                                                        size_t       count,
+                                                        uint16_t     weight) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i half = _mm256_set1_epi16(128);
+    const __m256i w    = _mm256_set1_epi16(weight);
+    const __m256i c    = _mm256_set1_epi16(256 - weight);
+
+    auto lerp = [&](__m256i x, __m256i y) __attribute__((target("avx2"))) {
+      __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(x, c), _mm256_mullo_epi16(y, w));
+      return _mm256_srli_epi16(_mm256_add_epi16(sum, half), 8);
+    };
+
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+      __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+      __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+
+      __m256i lo = lerp(_mm256_unpacklo_epi8(x, zero), _mm256_unpacklo_epi8(y, zero));
+      __m256i hi = lerp(_mm256_unpackhi_epi8(x, zero), _mm256_unpackhi_epi8(y, zero));
+
+      _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+
+    _mm256_zeroupper();
+    pLerpSSE2(a + i, b + i, dst + i, count - i, weight);
+  }
+#endif
+
+  void BlendBuffer(const Pixel* src, Pixel* dst, size_t count) { Blend::Buffer(src, dst, count); }
+
+  ParticleSystem::ParticleSystem(uint32_t capacity) { Reserve(capacity); }
+
+  ParticleSystem::~ParticleSystem() {
+    pFree(pX);
+    pFree(pY);
+    pFree(pVX);
+    pFree(pVY);
+    pFree(pColors);
+  }
+
+  uint32_t ParticleSystem::Emit(const vf2d& position, const vf2d& velocity, const Pixel& color) {
+    if (pSize == pCapacity) Reserve(std::max(64u, pCapacity * 2));
+
+    pX[pSize]      = position.x;
+    pY[pSize]      = position.y;
+    pVX[pSize]     = velocity.x;
+    pVY[pSize]     = velocity.y;
+    pColors[pSize] = color;
+
+    return pSize++;
+  }
+
+  void ParticleSystem::Kill(uint32_t index) {
+    if (index >= pSize) return;
+
+    pSize--;
+
+    pX[index]      = pX[pSize];
+    pY[index]      = pY[pSize];
+    pVX[index]     = pVX[pSize];
+    pVY[index]     = pVY[pSize];
+    pColors[index] = pColors[pSize];
+  }
+
+  void ParticleSystem::Clear() { pSize = 0; }
+
+  void ParticleSystem::Reserve(uint32_t capacity) {
+    if (capacity <= pCapacity) return;
+
+    pGrow(pX, pSize, capacity);
+    pGrow(pY, pSize, capacity);
+    pGrow(pVX, pSize, capacity);
+    pGrow(pVY, pSize, capacity);
+    pGrow(pColors, pSize, capacity);
+
+    pCapacity = capacity;
+  }
+
+  void ParticleSystem::Integrate(float et, const vf2d& acceleration) {
+    float far = std::numeric_limits<float>::max();
+    Integrate(et, acceleration, vf2d(-far, -far), vf2d(far, far));
+  }
+
+  void ParticleSystem::Integrate(float et, const vf2d& acceleration, const vf2d& min, const vf2d& max) {
+    pKernels().integrate(pX, pY, pVX, pVY, pSize, {et, acceleration * et, min, max});
+  }
+
+  uint32_t ParticleSystem::Size() const { return pSize; }
+
+  float* ParticleSystem::X() const { return pX; }
+  float* ParticleSystem::Y() const { return pY; }
+  float* ParticleSystem::VX() const { return pVX; }
+  float* ParticleSystem::VY() const { return pVY; }
+  Pixel* ParticleSystem::Colors() const { return pColors; }
+
+  const char* ParticleSystem::Kernel() { return pKernels().name; }
+
+  std::vector<ParticleSystem::kernels_t> ParticleSystem::pAvailable() {
+    std::vector<kernels_t> kernels = {{"scalar", &ParticleSystem::pIntegrateScalar}};
+#ifdef PIXEL_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse2")) kernels.push_back({"sse2", &ParticleSystem::pIntegrateSSE2});
+    if (__builtin_cpu_supports("avx2")) kernels.push_back({"avx2", &ParticleSystem::pIntegrateAVX2});
+#endif
+    return kernels;
+  }
+
+  const ParticleSystem::kernels_t& ParticleSystem::pKernels() {
+    static const kernels_t kernels = pAvailable().back();
+    return kernels;
+  }
+
+  // The step carries the velocity change of the step rather than the acceleration, and the vector kernels do the
+  // same operations in the same order as this one. The clamps are written the way maxps and minps compare, which
+  // return their second operand for NaN and for zeros of either sign, so all kernels agree on those too
+  void ParticleSystem::pIntegrateScalar(float* x, float* y, float* vx, float* vy, size_t count, const step_t& step) {
+    for (size_t i = 0; i < count; i++) {
+      vx[i] += step.acceleration.x;
+      vy[i] += step.acceleration.y;
+      x[i] += vx[i] * step.et;
+      y[i] += vy[i] * step.et;
+
+      if (x[i] < step.min.x || x[i] > step.max.x) vx[i] = -vx[i];
+      if (y[i] < step.min.y || y[i] > step.max.y) vy[i] = -vy[i];
+
+      x[i] = x[i] > step.min.x ? x[i] : step.min.x;
+      y[i] = y[i] > step.min.y ? y[i] : step.min.y;
+      x[i] = x[i] < step.max.x ? x[i] : step.max.x;
+      y[i] = y[i] < step.max.y ? y[i] : step.max.y;
+    }
+  }
+
+#ifdef PIXEL_X86
+  void ParticleSystem::pIntegrateSSE2(float* x, float* y, float* vx, float* vy, size_t count, const step_t& step) {
+    const __m128 et   = _mm_set1_ps(step.et);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+
+    auto axis = [&](float* p, float* v, float dv, float min, float max, size_t i) {
+      __m128 lo = _mm_set1_ps(min);
+      __m128 hi = _mm_set1_ps(max);
+
+      __m128 vel = _mm_add_ps(_mm_load_ps(v + i), _mm_set1_ps(dv));
+      __m128 pos = _mm_add_ps(_mm_load_ps(p + i), _mm_mul_ps(vel, et));
+      __m128 out = _mm_or_ps(_mm_cmplt_ps(pos, lo), _mm_cmpgt_ps(pos, hi));
+
+      _mm_store_ps(v + i, _mm_xor_ps(vel, _mm_and_ps(out, sign)));
+      _mm_store_ps(p + i, _mm_min_ps(_mm_max_ps(pos, lo), hi));
+    };
+
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+      axis(x, vx, step.acceleration.x, step.min.x, step.max.x, i);
+      axis(y, vy, step.acceleration.y, step.min.y, step.max.y, i);
+    }
+
+    pIntegrateScalar(x + i, y + i, vx + i, vy + i, count - i, step);
+  }
+
+  __attribute__((target("avx2"))) void ParticleSystem::pIntegrateAVX2(float*        x,
+                                                                      float*        y,
+                                                                      float*        vx,
+                                                                      float*        vy,
+                                                                      size_t        count,
+                                                                      const step_t& step) {
+    const __m256 et   = _mm256_set1_ps(step.et);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+
+    auto axis = [&](float* p, float* v, float dv, float min, float max, size_t i) __attribute__((target("avx2"))) {
+      __m256 lo = _mm256_set1_ps(min);
+      __m256 hi = _mm256_set1_ps(max);
+
+      __m256 vel = _mm256_add_ps(_mm256_load_ps(v + i), _mm256_set1_ps(dv));
+      __m256 pos = _mm256_add_ps(_mm256_load_ps(p + i), _mm256_mul_ps(vel, et));
+      __m256 out = _mm256_or_ps(_mm256_cmp_ps(pos, lo, _CMP_LT_OQ), _mm256_cmp_ps(pos, hi, _CMP_GT_OQ));
+
+      _mm256_store_ps(v + i, _mm256_xor_ps(vel, _mm256_and_ps(out, sign)));
+      _mm256_store_ps(p + i, _mm256_min_ps(_mm256_max_ps(pos, lo), hi));
+    };
+
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+      axis(x, vx, step.acceleration.x, step.min.x, step.max.x, i);
+      axis(y, vy, step.acceleration.y, step.min.y, step.max.y, i);
+    }
+
+    // The call below becomes a jump that skips vzeroupper, which would leave the SSE2 tail and the caller slowed down
+    _mm256_zeroupper();
+    pIntegrateSSE2(x + i, y + i, vx + i, vy + i, count - i, step);
+  }
+#endif
+
+  template <typename T>
+  void ParticleSystem::pGrow(T*& array, uint32_t size, uint32_t capacity) {
+    T* grown = static_cast<T*>(::operator new[](capacity * sizeof(T), std::align_val_t(pAlignment)));
+
+    if (array) std::memcpy(static_cast<void*>(grown), array, size * sizeof(T));
+
+    pFree(array);
+    array = grown;
+  }
+
+  template <typename T>
+  void ParticleSystem::pFree(T* array) {
+    if (array) ::operator delete[](array, std::align_val_t(pAlignment));
+  }
+
+  SpritePool& SpritePool::pInstance() {
+    // Never destroyed, so sprites outliving static destruction can still give their blocks back
+    static SpritePool* pool = new SpritePool();
+    return *pool;
+  }
+
+  uint32_t SpritePool::pSizeClass(uint32_t pixels) {
+    if (pixels > (1u << (pMinClassBits + pClasses - 1))) return pUnpooled;
+    if (pixels <= (1u << pMinClassBits)) return 0;
+
+    return std::bit_width(pixels - 1) - pMinClassBits;
+  }
+
+  size_t SpritePool::pBlockBytes(uint32_t size_class, uint32_t pixels) {
+    if (size_class == pUnpooled) return (size_t)pixels * sizeof(Pixel);
+    return ((size_t)1 << (size_class + pMinClassBits)) * sizeof(Pixel);
+  }
+
+  Pixel* SpritePool::Allocate(uint32_t pixels) {
+    SpritePool& pool       = pInstance();
+    uint32_t    size_class = pSizeClass(pixels);
+    size_t      bytes      = pBlockBytes(size_class, pixels);
+    void*       block      = nullptr;
+
+    {
+      std::lock_guard<std::mutex> lock(pool.pMutex);
+
+      pool.pAllocations++;
+      pool.pBytesInUse += bytes;
+
+      if (size_class != pUnpooled && !pool.pFree[size_class].empty()) {
+        block = pool.pFree[size_class].back();
+        pool.pFree[size_class].pop_back();
+
+        pool.pHits++;
+        pool.pBytesCached -= bytes;
+      }
+    }
+
+    if (!block) {
+      block = ::operator new(pHeaderBytes + bytes, std::align_val_t(pAlignment));
+
+      // Only unpooled blocks need their pixel count, every other block size follows from its class
+      *static_cast<block_header_t*>(block) = {size_class, pixels};
+    }
+
+    return reinterpret_cast<Pixel*>(static_cast<uint8_t*>(block) + pHeaderBytes);
+  }
+
+  void SpritePool::Free(Pixel* buffer) {
+    if (!buffer) return;
+
+    SpritePool& pool       = pInstance();
+    void*       block      = reinterpret_cast<uint8_t*>(buffer) - pHeaderBytes;
+    auto*       header     = static_cast<block_header_t*>(block);
+    uint32_t    size_class = header->size_class;
+    size_t      bytes      = pBlockBytes(size_class, header->pixels);
+
+    {
+      std::lock_guard<std::mutex> lock(pool.pMutex);
+
+      pool.pBytesInUse -= bytes;
+
+      if (size_class != pUnpooled && pool.pBytesCached + bytes <= pMaxCached) {
+        pool.pFree[size_class].push_back(block);
+        pool.pBytesCached += bytes;
+
+        return;
+      }
+    }
+
+    ::operator delete(block, std::align_val_t(pAlignment));
+  }
+
+  void SpritePool::Trim() {
+    SpritePool& pool = pInstance();
+
+    std::vector<std::vector<void*>> blocks(pClasses);
+
+    {
+      std::lock_guard<std::mutex> lock(pool.pMutex);
+
+      std::swap(blocks, pool.pFree);
+      pool.pBytesCached = 0;
+    }
+
+    for (auto& list : blocks) {
+      for (void* block : list) ::operator delete(block, std::align_val_t(pAlignment));
+    }
+  }
+
+  PoolStats SpritePool::Stats() {
+    SpritePool& pool = pInstance();
+    PoolStats   stats;
+
+    std::lock_guard<std::mutex> lock(pool.pMutex);
+
+    stats.allocations  = pool.pAllocations;
+    stats.hits         = pool.pHits;
+    stats.bytes_in_use = pool.pBytesInUse;
+    stats.bytes_cached = pool.pBytesCached;
+    stats.hit_rate     = pool.pAllocations ? (float)pool.pHits / pool.pAllocations : 0.0f;
+
+    return stats;
+  }
+
+  Sprite::Sprite(uint32_t w, uint32_t h, bool initialize) {
+    pSize.x = w;
+    pSize.y = h;
+
+    pBuffer = SpritePool::Allocate(w * h);
+    if (initialize) Blend::Clear(pBuffer, w * h, Pixel());
+  }
+
+  Sprite::~Sprite() { SpritePool::Free(pBuffer); }
+
+  Sprite::Sprite(const std::string& filename) {
+    if (FileUtil::LoadImage(this, filename) != rcode::ok)
+      throw std::runtime_error(std::string("Cannot open: ") + filename);
+  }
+
+  Sprite::Sprite(const Sprite& src) : pSize(src.pSize), pUvScale(src.pUvScale), pBufferId(src.pBufferId) {
+    // An atlas slot belongs to a single sprite, so a copy of a packed sprite has to be registered on its own
+    if (src.pAtlasEntry) {
+      pUvScale  = vf2d(1.0f, 1.0f);
+      pBufferId = 0xFFFFFFFF;
+    }
+
+    pBuffer = SpritePool::Allocate(src.pSize.prod());
+    if (src.pBuffer) std::memcpy(pBuffer, src.pBuffer, src.pSize.prod() * sizeof(Pixel));
+  }
+
+  Sprite& Sprite::operator=(const Sprite& rhs) {
+    Sprite copy(rhs);
+    Swap(copy);
+    return *this;
+  }
+
+  Sprite::Sprite(Sprite&& src) noexcept {
+    pBuffer = nullptr;
+    Swap(src);
+  }
+
+  Sprite& Sprite::operator=(Sprite&& rhs) noexcept {
+    Swap(rhs);
+    return *this;
+  }
+
+  Pixel Sprite::GetPixel(uint32_t x, uint32_t y) const {
+    if (x < pSize.x && y < pSize.y) {
+      return pBuffer[y * pSize.x + x];
+
+    } else {
+      return Pixel(0, 0, 0, 0);
+    }
+  }
+
+  void Sprite::SetPixel(uint32_t x, uint32_t y, const Pixel& p) {
+    if (x < pSize.x && y < pSize.y) {
+      pBuffer[y * pSize.x + x] = p;
+    }
+  }
+
+  vu2d Sprite::GetSize() const { return pSize; }
+
+  void Sprite::Swap(Sprite& other) noexcept {
+    std::swap(pSize, other.pSize);
+    std::swap(pUvScale, other.pUvScale);
+    std::swap(pUvOffset, other.pUvOffset);
+
+    std::swap(pBuffer, other.pBuffer);
+    std::swap(pBufferId, other.pBufferId);
+
+    std::swap(pAtlasEntry, other.pAtlasEntry);
+    if (pAtlasEntry) pAtlasEntry->sprite = this;
+    if (other.pAtlasEntry) other.pAtlasEntry->sprite = &other;
+  }
+}
+
+namespace pixel {
+  JobSystem::JobSystem(uint32_t threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (uint32_t i = 0; i < threads; i++) pQueues.push_back(std::make_unique<job_queue_t>());
+
+    // The thread waiting on a batch does its share of the work, so one less worker is spawned
+    for (uint32_t i = 1; i < threads; i++) {
+      pThreads.emplace_back(&JobSystem::pWorker, this, i);
+    }
+  }
+
+  JobSystem::~JobSystem() {
+    {
+      std::lock_guard<std::mutex> lock(pSleepMutex);
+      pStopping = true;
+    }
+
+    pWake.notify_all();
+    for (auto& t : pThreads) t.join();
+  }
+
+  JobSystem& JobSystem::Shared() {
+    static JobSystem shared;
+    return shared;
+  }
+
+  namespace {
+    thread_local const JobSystem* pWorkerOf    = nullptr;
+    thread_local uint32_t         pWorkerQueue = 0;
+  }
+
+  uint32_t JobSystem::pQueueIndex() const { return pWorkerOf == this ? pWorkerQueue : 0; }
+
+  void JobSystem::Submit(std::function<void()> job, counter_t& counter) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+
+    job_queue_t& queue = *pQueues[pQueueIndex()];
+
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.jobs.push_back({std::move(job), &counter});
+    }
+
+    pPending.fetch_add(1, std::memory_order_release);
+
+    // Taking the sleep mutex orders this against a worker that just found nothing to do, so its wake up is not lost
+    { std::lock_guard<std::mutex> lock(pSleepMutex); }
+    pWake.notify_one();
+  }
+
+  void JobSystem::Wait(counter_t& counter) {
+    uint32_t queue = pQueueIndex();
+
+    while (counter.load(std::memory_order_acquire) != 0) {
+      if (!pRunOne(queue)) std::this_thread::yield();
+    }
+  }
+
+  uint32_t JobSystem::Size() const { return pThreads.size() + 1; }
+
+  // Own jobs are taken newest first, as their data is the most likely to still be in cache, while stolen ones are the
+  // oldest, which tend to be the largest pieces of work left
+  bool JobSystem::pRunOne(uint32_t queue) {
+    job_t job;
+    bool  found = false;
+
+    for (uint32_t i = 0; i < pQueues.size() && !found; i++) {
+      job_queue_t& q = *pQueues[(queue + i) % pQueues.size()];
+
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (q.jobs.empty()) continue;
+
+      if (i == 0) {
+        job = std::move(q.jobs.back());
+        q.jobs.pop_back();
+
+      } else {
+        job = std::move(q.jobs.front());
+        q.jobs.pop_front();
+      }
+
+      found = true;
+    }
+
+    if (!found) return false;
+
+    pPending.fetch_sub(1, std::memory_order_relaxed);
+
+    job.task();
+    job.counter->fetch_sub(1, std::memory_order_release);
+
+    return true;
+  }
+
+  void JobSystem::pWorker(uint32_t queue) {
+    pWorkerOf    = this;
+    pWorkerQueue = queue;
+
+    while (!pStopping) {
+      if (pRunOne(queue)) continue;
+
+      std::unique_lock<std::mutex> lock(pSleepMutex);
+      pWake.wait(lock, [&]() { return pStopping || pPending.load(std::memory_order_acquire) > 0; });
+    }
+  }
+
+  uint32_t JobSystem::pChunks(uint32_t count, uint32_t grain) const {
+    return grain ? (count + grain - 1) / grain : std::min(count, Size() * 4);
+  }
+
+  template <typename F>
+  void JobSystem::ParallelFor(uint32_t count, F&& body, uint32_t grain) {
+    uint32_t chunks = pChunks(count, grain);
+    uint32_t step   = chunks ? (count + chunks - 1) / chunks : 0;
+
+    std::atomic<uint32_t> next {0};
+
+    auto run = [&]() {
+      for (uint32_t c = next++; c < chunks; c = next++) {
+        for (uint32_t i = c * step; i < std::min(count, (c + 1) * step); i++) body(i);
+      }
+    };
+
+    counter_t counter {0};
+
+    for (uint32_t i = 1; i < std::min(chunks, Size()); i++) Submit(run, counter);
+
+    run();
+    Wait(counter);
+  }
+
+  template <typename T, typename M, typename R>
+  T JobSystem::ParallelReduce(uint32_t count, T identity, M&& map, R&& reduce, uint32_t grain) {
+    uint32_t chunks = pChunks(count, grain);
+    uint32_t step   = chunks ? (count + chunks - 1) / chunks : 0;
+
+    std::vector<T> partial(chunks, identity);
+
+    ParallelFor(
+        chunks,
+        [&](uint32_t c) {
+          for (uint32_t i = c * step; i < std::min(count, (c + 1) * step); i++) partial[c] = reduce(partial[c], map(i));
+        },
+        1);
+
+    T result = identity;
+    for (const T& value : partial) result = reduce(result, value);
+
+    return result;
+  }
+
+  uint32_t TaskGraph::Add(std::function<void()> task, const std::vector<uint32_t>& after) {
+    uint32_t index = pNodes.size();
+
+    for (uint32_t dependency : after) {
+      if (dependency >= index) throw std::runtime_error("Tasks can only come after tasks added before them");
+    }
+
+    node_t& node      = pNodes.emplace_back();
+    node.task         = std::move(task);
+    node.dependencies = after.size();
+
+    for (uint32_t dependency : after) pNodes[dependency].successors.push_back(index);
+
+    return index;
+  }
+
+  void TaskGraph::Run(JobSystem& jobs) {
+    JobSystem::counter_t counter {0};
+
+    for (node_t& node : pNodes) node.remaining = node.dependencies;
+
+    for (uint32_t i = 0; i < pNodes.size(); i++) {
+      if (pNodes[i].dependencies == 0) pSubmit(jobs, counter, i);
+    }
+
+    jobs.Wait(counter);
+  }
+
+  // Successors are submitted before the finished task is counted out, so the counter never reads zero early
+  void TaskGraph::pSubmit(JobSystem& jobs, JobSystem::counter_t& counter, uint32_t index) {
+    jobs.Submit(
+        [this, &jobs, &counter, index]() {
+          pNodes[index].task();
+
+          for (uint32_t successor : pNodes[index].successors) {
+            if (pNodes[successor].remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+              pSubmit(jobs, counter, successor);
+            }
+          }
+        },
+        counter);
+  }
+}
+
+namespace pixel {
+  template <typename T>
+  SpatialGrid<T>::SpatialGrid(const vf2d& min, const vf2d& max, float cell_size) {
+    if (cell_size <= 0.0f || max.x <= min.x || max.y <= min.y) throw std::runtime_error("Invalid spatial grid bounds");
+
+    pMin         = min;
+    pInvCellSize = 1.0f / cell_size;
+    pCells       = vu2d(std::ceil((max.x - min.x) * pInvCellSize), std::ceil((max.y - min.y) * pInvCellSize));
+
+    pCellStart.assign(pCells.prod() + 1, 0);
+  }
+
+  template <typename T>
+  void SpatialGrid<T>::Clear() {
+    pInserted.clear();
+    pInsertedCells.clear();
+  }
+
+  template <typename T>
+  void SpatialGrid<T>::Insert(const vf2d& position, const T& item) {
+    vu2d cell = pCell(position);
+
+    pInserted.push_back({position, item});
+    pInsertedCells.push_back(cell.y * pCells.x + cell.x);
+  }
+
+  template <typename T>
+  void SpatialGrid<T>::Build() {
+    std::fill(pCellStart.begin(), pCellStart.end(), 0);
+
+    for (uint32_t cell : pInsertedCells) pCellStart[cell + 1]++;
+    for (uint32_t i = 1; i < pCellStart.size(); i++) pCellStart[i] += pCellStart[i - 1];
+
+    // Scattering advances a copy of the starts, so items keep their insertion order within a cell
+    std::vector<uint32_t> next(pCellStart.begin(), pCellStart.end() - 1);
+
+    pEntries.resize(pInserted.size());
+    for (uint32_t i = 0; i < pInserted.size(); i++) pEntries[next[pInsertedCells[i]]++] = pInserted[i];
+  }
+
+  template <typename T>
+  template <typename F>
+  void SpatialGrid<T>::QueryRadius(const vf2d& center, float radius, F&& visit) const {
+    float r2 = radius * radius;
+
+    pVisit(pCell(center - radius), pCell(center + radius), [&](const vf2d& position, const T& item) {
+      vf2d d = position - center;
+      if (d.x * d.x + d.y * d.y <= r2) visit(position, item);
+    });
+  }
+
+  template <typename T>
+  template <typename F>
+  void SpatialGrid<T>::QueryRect(const vf2d& min, const vf2d& max, F&& visit) const {
+    pVisit(pCell(min), pCell(max), [&](const vf2d& position, const T& item) {
+      if (position.x >= min.x && position.y >= min.y && position.x <= max.x && position.y <= max.y) {
+        visit(position, item);
+      }
+    });
+  }
+
+  template <typename T>
+  uint32_t SpatialGrid<T>::Size() const {
+    return pEntries.size();
+  }
+
+  template <typename T>
+  vu2d SpatialGrid<T>::pCell(const vf2d& position) const {
+    vf2d cell = (position - pMin) * pInvCellSize;
+
+    return vu2d(std::clamp(cell.x, 0.0f, pCells.x - 1.0f), std::clamp(cell.y, 0.0f, pCells.y - 1.0f));
+  }
+
+  // The cells of a row are adjacent in the sorted entries, so each row of the range is a single run
+  template <typename T>
+  template <typename F>
+  void SpatialGrid<T>::pVisit(const vu2d& first, const vu2d& last, F&& visit) const {
+    for (uint32_t y = first.y; y <= last.y; y++) {
+      uint32_t begin = pCellStart[y * pCells.x + first.x];
+      uint32_t end   = pCellStart[y * pCells.x + last.x + 1];
+
+      for (uint32_t i = begin; i < end; i++) visit(pEntries[i].position, pEntries[i].item);
+    }
+  }
+}
+
+namespace pixel {
+  QuadTree::QuadTree(float theta, float softening) : pTheta(theta), pSoftening(softening) {}
+
+  void QuadTree::Build(const std::vector<vf2d>& positions, const std::vector<float>& masses) {
+    uint32_t count = positions.size();
+
+    pNodes.clear();
+    pKeys.resize(count);
+    pPositions.resize(count);
+    pMasses.resize(count);
+
+    if (count == 0) return;
+
+    vf2d min = positions[0];
+    vf2d max = positions[0];
+
+    for (const vf2d& p : positions) {
+      min = vf2d(std::min(min.x, p.x), std::min(min.y, p.y));
+      max = vf2d(std::max(max.x, p.x), std::max(max.y, p.y));
+    }
+
+    float size  = std::max({max.x - min.x, max.y - min.y, 1e-6f});
+    float scale = 65535.0f / size;
+
+    for (uint32_t i = 0; i < count; i++) {
+      vf2d     cell = (positions[i] - min) * scale;
+      uint32_t key  = pSpread(cell.x) | (pSpread(cell.y) << 1);
+
+      pKeys[i] = ((uint64_t)key << 32) | i;
+    }
+
+    std::sort(pKeys.begin(), pKeys.end());
+
+    for (uint32_t k = 0; k < count; k++) {
+      pPositions[k] = positions[(uint32_t)pKeys[k]];
+      pMasses[k]    = masses[(uint32_t)pKeys[k]];
+    }
+
+    pBuild(0, count, 0, size);
+  }
+
+  // Nodes are laid out depth first, so a node's children follow it and its subtree ends where next points
+  void QuadTree::pBuild(uint32_t begin, uint32_t end, uint32_t shift, float size) {
+    uint32_t index = pNodes.size();
+    pNodes.push_back({vf2d(0.0f, 0.0f), 0.0f, size, begin, end, 0});
+
+    vf2d  moment(0.0f, 0.0f);
+    float mass = 0.0f;
+
+    if (end - begin <= pLeafSize || shift == 32) {
+      for (uint32_t k = begin; k < end; k++) {
+        moment += pPositions[k] * pMasses[k];
+        mass += pMasses[k];
+      }
+
+    } else {
+      // Keys are sorted, so the quadrants are consecutive runs of the next two bits
+      auto digit = [&](uint64_t key) { return (key >> (62 - shift)) & 3; };
+
+      uint32_t first = begin;
+
+      for (uint64_t quadrant = 0; quadrant < 4; quadrant++) {
+        uint32_t last = std::partition_point(pKeys.begin() + first, pKeys.begin() + end, [&](uint64_t key) {
+                          return digit(key) <= quadrant;
+                        }) -
+                        pKeys.begin();
+
+        if (last > first) {
+          uint32_t child = pNodes.size();
+          pBuild(first, last, shift + 2, size / 2);
+
+          moment += pNodes[child].center * pNodes[child].mass;
+          mass += pNodes[child].mass;
+        }
+
+        first = last;
+      }
+    }
+
+    pNodes[index].center = mass > 0.0f ? moment / mass : pPositions[begin];
+    pNodes[index].mass   = mass;
+    pNodes[index].next   = pNodes.size();
+  }
+
+  vf2d QuadTree::Acceleration(const vf2d& position, float g) const {
+    vf2d  acceleration(0.0f, 0.0f);
+    float theta2 = pTheta * pTheta;
+    float soft2  = pSoftening * pSoftening;
+
+    auto pull = [&](const vf2d& center, float mass) {
+      vf2d  d  = center - position;
+      float r2 = d.x * d.x + d.y * d.y;
+
+      if (r2 == 0.0f) return;
+
+      r2 += soft2;
+      acceleration += d * (mass / (r2 * std::sqrt(r2)));
+    };
+
+    for (uint32_t i = 0; i < pNodes.size();) {
+      const node_t& node = pNodes[i];
+
+      vf2d  d  = node.center - position;
+      float r2 = d.x * d.x + d.y * d.y;
+
+      if (node.size * node.size < theta2 * r2) {
+        pull(node.center, node.mass);
+        i = node.next;
+
+      } else if (node.next == i + 1) {
+        for (uint32_t k = node.begin; k < node.end; k++) pull(pPositions[k], pMasses[k]);
+        i = node.next;
+
+      } else {
+        i++;
+      }
+    }
+
+    return acceleration * g;
+  }
+
+  void QuadTree::Accelerations(JobSystem& jobs, float g, std::vector<vf2d>& out) const {
+    out.resize(pKeys.size());
+
+    jobs.ParallelFor(pKeys.size(), [&](uint32_t k) { out[(uint32_t)pKeys[k]] = Acceleration(pPositions[k], g); });
+  }
+
+  void  QuadTree::SetTheta(float theta) { pTheta = theta; }
+  float QuadTree::theta() const { return pTheta; }
+
+  uint32_t QuadTree::Nodes() const { return pNodes.size(); }
+
+  uint32_t QuadTree::pSpread(uint32_t bits) {
+    bits &= 0xFFFF;
+    bits = (bits | (bits << 8)) & 0x00FF00FF;
+    bits = (bits | (bits << 4)) & 0x0F0F0F0F;
+    bits = (bits | (bits << 2)) & 0x33333333;
+    bits = (bits | (bits << 1)) & 0x55555555;
+
+    return bits;
+  }
+}
+
+#ifdef PIXEL_TRACE
+namespace pixel {
+  Tracer::thread_buffer_t& Tracer::pLocalBuffer() {
+    thread_local thread_buffer_t* buffer = nullptr;
+
+    if (!buffer) {
+      std::lock_guard<std::mutex> lock(pMutex);
+
+      buffer     = pBuffers.emplace_back(std::make_unique<thread_buffer_t>()).get();
+      buffer->id = pBuffers.size();
+    }
+
+    return *buffer;
+  }
+
+  void Tracer::NameThread(const char* name) { pLocalBuffer().name = name; }
+
+  void Tracer::Record(const char*                           name,
+                      std::chrono::steady_clock::time_point begin,
+                      std::chrono::steady_clock::time_point end) {
+    thread_buffer_t& buffer = pLocalBuffer();
+
+    uint64_t count = buffer.count.load(std::memory_order_relaxed);
+    uint64_t block = count / pBlockSize;
+
+    if (block == pMaxBlocks) {
+      buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    if (count % pBlockSize == 0) buffer.blocks[block] = std::make_unique<trace_event_t[]>(pBlockSize);
+
+    buffer.blocks[block][count % pBlockSize] = {
+        name,
+        (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(begin - pEpoch).count(),
+        (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()};
+
+    buffer.count.store(count + 1, std::memory_order_release);
+  }
+
+  rcode Tracer::Flush(const std::string& filename) {
+    FILE* file = fopen(filename.c_str(), "w");
+    if (!file) return rcode::file_err;
+
+    auto escaped = [](const char* name) {
+      std::string out;
+      for (const char* c = name; *c; c++) {
+        if (*c == '"' || *c == '\\') out += '\\';
+        out += *c;
+      }
+
+      return out;
+    };
+
+    std::lock_guard<std::mutex> lock(pMutex);
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+    bool first = true;
+
+    for (auto& buffer : pBuffers) {
+      const char* name    = buffer->name.load();
+      uint64_t    count   = buffer->count.load(std::memory_order_acquire);
+      uint64_t    dropped = buffer->dropped.load(std::memory_order_relaxed);
+
+      fprintf(file,
+              "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": "
+              "\"%s\"}}",
+              first ? "" : ",\n",
+              buffer->id,
+              name ? escaped(name).c_str() : ("thread " + std::to_string(buffer->id)).c_str());
+      first = false;
+
+      if (dropped) {
+        fprintf(file,
+                ",\n{\"name\": \"dropped events\", \"ph\": \"C\", \"pid\": 1, \"tid\": %u, \"ts\": 0, "
+                "\"args\": {\"dropped\": %llu}}",
+                buffer->id,
+                (unsigned long long)dropped);
+      }
+
+      for (uint64_t i = 0; i < count; i++) {
+        const trace_event_t& event = buffer->blocks[i / pBlockSize][i % pBlockSize];
+
+        fprintf(file,
+                ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                escaped(event.name).c_str(),
+                buffer->id,
+                event.begin / 1000.0,
+                event.duration / 1000.0);
+      }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    return rcode::ok;
+  }
+
+  TraceScope::TraceScope(const char* name) : pName(name), pBegin(std::chrono::steady_clock::now()) {}
+  TraceScope::~TraceScope() { Tracer::Record(pName, pBegin, std::chrono::steady_clock::now()); }
+}
+#endif
+
+namespace pixel {
+  // Base64 encoded 1805x32 monochromatic ascii font sheet. Using "Source Code Pro 32" as font
+  static constexpr char pFontBase64[] =
+      "AAAAAAAAAAAAAGAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAADAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAcAAAAAAAAAAAAAAAAAAAAAAMAAAAAAAAAAAABCAA"
+      "AAAAAAAAAAAAAAAAAAADAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA4D9wAID/AA"
+      "AAAAAAOAAAAMABAAAAAIABAAAA/AAAAAcAABwA4AAOAPgPAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAwAA6AAQAAAAAAAOAA8HAAAACAAQAAAAAAgAMAwAEOAAAAAAAAAAAAAAAAAABwAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA4A8AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAPwHDADwHwAAAAAAAA4AAAA4AAAAAAAwAAAA4D8AAO"
+      "AAAMADAB7AAQD/AQAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAADwB8AB8AcAAAAAAAAcAB4Og"
+      "GEAMAAeAIAPAHAAAByAAwAAAAAAAAAAAAAAAAAABsAHADgA+AHADwDAAfw/AH7A/x/ADwA/AAAAAAAAAAAA"
+      "AAAAAP8DAAAAHAD/AwA/wH8A/H/g/wPwAwzg4P8D/h84wIEDAA94cIAD+AD8DwA+AP8DgB/w/x8GcBgAdwB"
+      "wDuA4AA7/P4ABgAEAAAMADgAAAIADAAAABwAAAAAABgAAABwEAAAcAAB4AMADOAAAOAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAwAAAAAAAAAAAAAAAAAAAAABgA4AMABAAAAAACAA8DDATAMgB/gDxj4AwAOAMAB4AAAAAAAAAAAA"
+      "AAAAAAA4AD+A/gHwP8A/gcAPID/B/A/+P8D/gPwDwAAAAAAAIAAAAACAODwAPADgAfg/wH4H/g/gP8P/H+A"
+      "/4EBHPx/wP8DBzxwAOABDw5wwH+A/wfwH+D/AfwP/v/DAA4HYBwAjgMODuDg/wcwAHAAAGAAwAMAAADgAAA"
+      "A4AAAAAAAwAAAAMABAACAAwAADgBwAAcAAAcAAAAAAAAAAAAAAAAAAAAAAIABAAAAAAAAAAAAAAAAAAAA4A"
+      "AABwAwAAAAAAAAcAB4OACGAPwPhoGDYwDAAQAYADgAAAAAAAAAAAAAAAAAAAzg8QD/ADwc4OEBgAcwAAAfB"
+      "wAw4OAAhwcAAAAAAAAYAADAAQAAHID/ANgAHHyAjweDDzAAgAMA+HwwgANwAABw4IADDgA84MEDDnwecOAB"
+      "nwcceMDnA+AAGMDhAI4DwGHAwQEcAGAABgAMAAAMAGwAAAAACAAAABwAAAAAABgAAAAYAAAAcAAAAAAAAOA"
+      "AAOAAAAAAAAAAAAAAAAAAAAAAAAAwAAAAAAAAAAAAAAAAAAAAAAwA4AAABgAAAAAAAA4ADwdAEMDDw2A4MA"
+      "wAOACAAQAGACAAAAMAAAAAAAAAAIABHBgAHIABBwxwANgABgBwAAAABww4cOAAAAAAAADAAwAAeAAAAAM4O"
+      "AAbgAMOeEBgwAMGAHAAgAMEBnAADgAADhw4wAGADT54wMEDBw5w8MCBAxw8YAAcAAM4HMBxABgcHHCAAQAO"
+      "wACAAwCAAYANAAAAAAAAAIADAAAAAAADAAAAAwAAAA4AAAAAAAAcAAAcAAAAAAAAAAAAAAAAAAAAAAAABgA"
+      "AAAAAAAAAAAAAAAAAAIABABwAwAAAAAAAAMAB4OAACAM4IBgMA4YDAAcAOADAAQAEAGAAAAAAAAAAAAA4wA"
+      "EHgAMAwAAADoAbwAAADgAAcMABBgc4AA4AAAAAHAAAADwAAGCAAwxgB3DAgQcADHDAAAAOADgAwAAOwAEAw"
+      "IGDAzgAsMEGHzg44MABDg44cICDAwCAA2AABwcYDoADhwEMOADgABgAYAAAMAA4AwAAAAAAAABwAAAAAABg"
+      "AAAAYAAAAMABAAAAAACAAwCAAwAAAAAAAAAAAAAAAAAAAAAAwAAAAAAAAAAAAAAAAAAAAAAwAIADABgAAAA"
+      "AAAA4ABgcgGEAAwCDMcAwAOAAAAMAMACAAAAMAAAAAAAAAAAAAxjAAHAAADgAwAE4AxgA4AAAAAY4wOAABu"
+      "ADAB4A4AEAAAAPAAAOOIAB7gAOMHAAgAEcGADAAQAHABjAATgAADhwOAAHAD7YYAOHAzg4gOEADg5wcAAAc"
+      "AAM4OCAw+Fw4DiAAwMADAADAAwAAAYAYwAAAAAAAPwAzgcAfgB8DMAP4P8H8H84PsD/AP4HcIADcADmcGD4"
+      "APABGB8APgYYfoA/wP8fDmAwAOYA4DjAYAAM/n8ADgBwAAADAAAAAAAABwCDA/5/YABgMAMYBwAcAGAAAA4"
+      "AMACAAQAAAAAAAAAAYAADOAAOAAAHADiAYwADABwAAGAABhgcwAB8AOADAA6A/w+ABwDAAAMwwBjAAQYGAD"
+      "CAAwMAOABwAAADOAAHAAAHjgPgAMCPH+zgcAAHBzAcwMEBDg4AAA6AARwccDgcDjgDYHAAwAFgAIADAMAAY"
+      "BwAAAAAAOB/wP0D8D/AvwH+B/z/gP8P8w/4H8D/AA44AA7Avh/MP4D/APMP4N8A4w/4H/j/wwEMDuAYHBwG"
+      "HByAwf8PwAEADgBgAAAAAAAAwABgMMD/DxwADCMAdwCAAwAOAMABCIYAMAAAAAAAAAAAAA5wAAfAAQBgAIA"
+      "DMAxgAIABAAAOwIGDAziADwB8APAA8P8B4AEAHHAABBgHOODgAAAGYGAAAAcADgBgAAfgAADgwHkAHAC4sY"
+      "MZHA7A4ACGAzA4wIEDAMABMIADAwaHxwF3ABwGABwADABgAAAYAAYDAAAAAAAfDvjxAB8PPD7g4QEwADgcY"
+      "McDgAMAHMCBA8ABeL6HHQ94PODHAx4fYJ+BgwdgADiAgQEcg4PBwQEDOADgADgAwAEADAAAAAAAABgADAbA"
+      "MAAPAGMAwAcAYADAAAAwAM8eAAYAAAAAAAAAAMAAjuMAOAAADgA8AIcB7AcwPgDAAHA4cAAH4AGADwAHAAA"
+      "AAHAAwAEGgIDjAAcPHADAABwMAOAAwAEADOAAHAAAHDgHgAMAN3Ywh8MAOBzgMAAOBzjwAQA4AAZw4MDA8D"
+      "jABwDjAIABgAEADAAAA8BgAAAAAABAgAMPHHCAwAEHHjAABgADBzxwAHAAgAM4OAA4AMfj8MCBAw48cOCAA"
+      "2wAOEAADAAHMHCA4fAwcBjgAAMADgAHADgAgAHAAQEAAAADgMEAGAbAB+AHAHgAAAwAGAAABsD/Af8fAADA"
+      "/wcAAAAcwHEcAAcAwAH4A3AwgP8D9x8AHAD8AwzwAAAA4ABwAAAAAAAcABzAgB8wGOB/gAMAGICD/wP8Pxg"
+      "AgP8fgAMAgAP3AXAA4OwOxnAYAIcDHAbA4cAD/AEAB8AADhwcGBsD8ADgDAA4ADAAgAMAYAAcHAAAAAAAAG"
+      "DgAAcHADjAwAEOwABwwIADHAAOAHAAhwMAB+AwHA5wcICDAxwcYIAHAAcAgAHgAAYOOBwaBowDGHAA4ADgA"
+      "AAHADAA/DAAAABgAAAAAEMA8AMgQIAHGAAAAAMAwADAD+D/AwAA+P8AAACAATieA+AAABwAfwAHBjDw4AcH"
+      "gAOAP4CHHwAAAAAADgAAAAAAA8ABGHwDBgf8P3AAAANw8H+A/wcDf/D/A3AAAHDgdwAOAJzNwTgOA+Bw4ME"
+      "AOPw/AP4A4AAYwAGDAWdjAA4A2AGAAwAGAGAAAAyAAQMAAAAAAAAMHODgAIADGBiAARgADhhwgAPAAQAO4D"
+      "gA4AAMhsMBDgdwcIDDAQxwAOABADAAHMCAAYNj44A7AAcGAA4ADADgAAAOwDgGAAAADAAAACAIAPABAD/4g"
+      "QMAAGAAADgA8AAAAwAAAAAAAAAAMADHcQAcAMABADxgwAAAHDzAATAAHB/gvwMAAAAAwAMAAAAAeAAYAMNh"
+      "4OCAAw4OAGAADgYAcADg4A8GcAAOAAAOfA7AAYCzORjGYQAc/h8YAIf/AwB+ABwAAzjgMODsDOADAB8AOAD"
+      "AAAAcAIABMGAAAAAAAAD4gQMcDABwAIMDMAADwAEDDnAAOADAAZwDAByAwXA4wOEADg5wOIABBgD4AAAGgA"
+      "MYcHBgbBzgA+DAAOAA+AAAHACADxh+AAAAgAEAAID/DwB4ADGOczAAAAAMAAAHABsAYAAAAAAAAAAAAAfgA"
+      "A6AAwA4AAAODhgAAIMDOAAHwIEH8HEAAAAAAOABAAAAgAMAA2AcDBwYcIDDAQAMwMEAAA4AHIDBAA7AAQDA"
+      "gYcDOABwHAfDOQyAw/8AA+BwOAAAD4ADYAAHHAecnQFsAMABAAcAGAAAAwAwAAAAAAAAAADwP3AAgwEADmD"
+      "w/wdgADBwwAEOAAcAOID7AIADMBgOBzgcgMEBDAcwwAAA/gHAAHAAAwwOjI0BOAAYHAAOAB8AgAMA4AEABw"
+      "AAAAAAAADw/wEADjCGMRwHAACAAQBgAHAGAAwAAAAAAAAAAGAAHMABcACAAwCA4f8fAOBgAAfgABjAAQAGA"
+      "AAAAAB4APx/ADwAAACMgYH/Bw5gOACAARgYAMABgAMwGMABOAAAOPBwAAcAjuNgMIcDMDgA4AAMDgcAgANw"
+      "AAzgAOOAOzvAHQA4AHAAAAMAYAAABgAAAAAAAACADwYOYDAAwAEM/v8ADAAOBzjAAeAAAAfwOwBwAAbD4QC"
+      "HAzA4gOEABhgAAP4AGAAOYIDDgLMzgA8AhwHgAQAHAHAAAAcAAAAAAAAAAAAAGAYAgAFHMAdnAAAAMAAADA"
+      "DGAYABAAAAAAAAAAAOAAMYAA4AOAAAMPz/AwAcDMAAHIADOADAAAAAAAAAPID/D8ABAACAMTD4/8ABDA4AM"
+      "IADAwA4AHAABgM4AAcAAAcOHOAAwHEcDO5wAAcHABzAwcEBAHAADoABHGAMYGMHHAcABwAHAGAAABwAwAAA"
+      "AAAAAAAAOMDAAQ4GADiAwQEAgAGAfwAHOAAcAOAAPg4ADsBgOBzgcAAHBzgcwAADAAA8AAPAAQxgHHBnBrA"
+      "BwDAAHADAAAAOAGAAAAAAAAAAAAAAAMMAADBwDObADwAAAAYAgAFgMAAwAAAAAAAAAADAAGAAA8ABgAMAAA"
+      "4ADACAgwMcgAFwAAcAHAAAAAAAAA8AAAAeAAAAMA4HBxg4gMEBAAZwYAAABwAcwGAAB+AAAODAgQMcADiAg"
+      "4EdDuDgAIADODg4AAAOwAFwgAGcAWz8gOMA4ADgAAAMAAADABgAAAAAAAAAAAMYOMDBAQAHMDgAADAA2APg"
+      "AAeAAwAcwIMBwAEYDIcDHA7g4ACHAxhgAAAADmAAOIABjAFu7AB3ADgHwAEAOADAAQAMAAAAAAAAHAAAAGA"
+      "YwAAHh8Ec8AAAAMAAADAABAQABgA4AAAAAB4AGAAccAA4ADgAAMAAgAEAOHCAAzAADuAAgAHgAQAHAIAHAA"
+      "DgAABwAIa/YAAHBzh4AMAABwwA4ACAAxgM4AAcAAIMOOCAAwAHcDDwgwMOHADgAAMHDgjAATgADjgAO4CND"
+      "zg4ABwADgCAAQBgAAADAAAAAAAAAGAAAwc4OADgAAYOAAAGgAMAHOAAcACAAzhwADgAg+FwgIMBHBzgcAAD"
+      "DAAAwAEMAAY4gDOAjR1wHABmABwAAAcAOACAAQAAAAAAwAcAAAAMA3jwYGAYBz4AAAA4AAAHAAAAAACADwA"
+      "AAOADgAMABwYAB8ADgAMcADBgAAccOAAHgAEcADgAPgDwAQDgAAAADgAAD8DgEQ7g4AAHHjAY8IABABwA4A"
+      "CDARyAA+DAAQc4cADgAA4GfPDAgQMAHHDggAMHOAAHwAMHYAPw4QEDBoAD4AAAMAAAHABgAAAAAAAAAAAMc"
+      "OCAAw4QOODAAwDAAHAAgAMcAA4AcAAHHAAHYDAcDnBwwIEDDhxwgAEAATiAA8CBB2AHsPEBBgfADsABAOAA"
+      "AAcAMAAAAAAAAPgAAACAYQD+DwYM4+EfAAAABgDgAAAAAAAA8AEAAAB8ADAA4PEA4AA8APDhAQAGPHgAhwf"
+      "gAPDggcMDwAcAPgAAEAAAQAAA4AEYAMABGBx4gI8Hgw8wAIADAHx8MIADcAA8PuAABw4AHMDBgA88HnAAAI"
+      "8HHHDg4wPgAPB5AHwAHjxwwAFwAAwAAAYAAAMADAAAAAAAAACAhw98PICHBx8f8OAAGAAeAHCAA8ABAA7gA"
+      "AfgIQyGwwEOPB7w8YCPDzAA8IED8CB43AB8ADY84OAA8AAcAAAcAOAAAAYAAAAAAAAfAAAAEAQAf4AAP/iP"
+      "AwAAwAAADAAAAAAAAH4AAACADwAGAPgP8P/D/x/4HwDAAP8HwH8AHAD8H/A/APgAwA8AAAAAAAAAADwABgA"
+      "YAIf/B+B/4P8A/j9wAAD+BwZw8P8B/wMcwMH/hwM4GOAB/wEOAMB/gAMc+D8AHAD8BwAPwIMHBnAADsD/H8"
+      "AAAOAAgAEAAAAAAAAA4L+B/QPgf8B/A/wfAAOA/wcOcAA4AMABHOAA+IfBcDjAAf8B/g/gvwEGAPg/APwH/"
+      "hkAD8CDBw44AB7A/x+AAQAcAMAAAAAAAADAAQAAAIIAAAMAwAN8YAAAADgAwAEAAAAAAIAPAAAA4ADgAAB8"
+      "AP5/+P8D/AAAGAA/AOADgAMA/gD4AQAOAPABAAAAAAAAAAAHwACAA+DwPwDwA/wHwP8HDgAAP8AADv4/gB+"
+      "AAzj4/3AABwM8gA/AAQDgB3CAA/wBgAMAfgDgAHjw4AAOwAH4/wMYAAAYADAAAAAAAAAAAPgxMD4A8APgYw"
+      "D+AGAA4P/DAQ4ABwA4gAM4AHwwGA4HOIAPwPkA8DHAAAD8AQB+gA8D4ABw8OAADsAD+P8DMACAAwAYAAAAA"
+      "AAAAAAAAAAAAGAAAAAAAAAAAAAGABgAAAAAAADAAQAAAAAADAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAA4AAAAAAAAAAAAADAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAOAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAwAAAwAGAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAdwAAAAAAAABwAAAAAAAAAAAA"
+      "AAADgAAAAGAAAAAAAAAAAAAAAAAAAAAAAwAAAAAAYAcAAAAwAAAAAAAAAAAAAAAAAMAAAAAAAAAACAAYADA"
+      "AAAAAAAGAAAAAAAwAEAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAwAAAAAAAAAAAAAOEAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA4AAAAAAAAAAAAAAAAAAAAAAAAAAAAAYAAA4ADAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAGAADgAAAAAA4AAAAAAAAAAAAAAAAAAHAADAAAAAAAAAAAAAAAAAAAAAAA"
+      "AABwAAAMAAAA4AYAAAAAAAAAAAAAAAAACAAQAAAAAAAAAAcAA4AAAAAAAAAAMAAAAAABgAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAYAAAAAAAAAAAAACABwMAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAIAHAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAwAABgAGAAAAP7/AAAAAAAAAAAAAAAAAAAAAAAOwAE"
+      "AAAAAABwAAAAAAAAAAAAAAADgAAAAGAAAAAAAAAAAAAAAAAAAAAAAYAAAAAA4AMABAA4AAAAAAAAAAAAAAA"
+      "AAMAAAAAAAAAAAAByAAwAAAAAAADAAAAAAAAADAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAYAAAAAA"
+      "AAAAAAA4H8AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAADgDwAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAID/AAAD/gMAAMD/HwAAAAAAAAAAAAAAAAAAAADAATgAAAAAAMABAAAAAAAAAAAAAAAAHAAAAAM"
+      "AAAAAAAAAAAAAAAAAAAAAAA4AAAAA/gA4AP4AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAHOAAAAAAAAAAHAA"
+      "AAAABwAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAOAAAAAAAAAAAAAAAOABAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA8AEAAAAAAAAAAAAAAAAAAAAAAAAAAADwHwDgwH8AAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAcMADAAAAADA8AAAAAAAAAAAAAAAAgAMAAGAAAAAAAAAAAAAAAAAAAAAAAOAAAAAAgB8"
+      "AB8APAAAAAAAAAAAAAAAAAAAAAAAAAAAAAABAAAIAAAAAAAB4AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAPAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAPwfAAAAAAD+AwAA"
+      "AAAAAAAAAAAAAHAAAAAMAAAAAAAAAAAAAAAAAAAAAMAPAAAAAAAA4AAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAgAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAABAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAD+AAAAAACAHwAAAAAAAAAAAAAAAAAOAACAAQAAAAAAAAAA"
+      "AAAAAAAAAAD4AAAAAAAAABwAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAIADAAAAAAA=";
+
+  // Decodes the sheet at compile time into 95 glyph cells of 32 rows. Each row is one word, bit x being column x of
+  // the 19 pixel wide cell, and bit m of the decoded stream being pixel m of the sheet in row major order
+  static constexpr std::array<uint32_t, 95 * 32> pDecodeFont() {
+    constexpr int8_t b64invs[] = {62, -1, -1, -1, 63, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1,
+                                  -1, -1, 0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14, 15, 16, 17,
+                                  18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1, -1, 26, 27, 28, 29, 30, 31,
+                                  32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51};
+
+    std::array<uint32_t, 95 * 32> rows = {};
+
+    uint32_t m = 0;
+
+    for (size_t i = 0; i + 4 < sizeof(pFontBase64); i += 4) {
+      uint32_t v     = 0;
+      uint32_t bytes = 3;
+
+      for (size_t k = 0; k < 4; k++) {
+        char c = pFontBase64[i + k];
+
+        if (c == '=') bytes--;
+        v = (v << 6) | (c == '=' ? 0 : b64invs[c - 43]);
+      }
+
+      for (uint32_t b = 0; b < bytes; b++) {
+        uint8_t byte = (v >> (16 - 8 * b)) & 0xFF;
+
+        for (uint32_t bit = 0; bit < 8 && m < 1805 * 32; bit++, m++) {
+          if (byte & (1 << bit)) rows[(m % 1805) / 19 * 32 + m / 1805] |= 1u << (m % 1805 % 19);
+        }
+      }
+    }
+
+    return rows;
+  }
+
+  static constexpr std::array<uint32_t, 95 * 32> pFontRows = pDecodeFont();
+}
+
+namespace pixel {
+  Application::Application(Application::params_t params) {
+    if (params.scale <= 0 || params.size.x <= 0 || params.size.y <= 0)
+      throw std::runtime_error("Invalid Application dimensions");
+
+    pPlatform.App = this;
+    pRenderer.App = this;
+
+    pWindowSize = params.size * params.scale;
+    pWindowPos  = params.position;
+
+    pScreenSize    = params.size;
+    pInvScreenSize = vf2d(1.0f / params.size.x, 1.0f / params.size.y);
+    pScreenRect    = {0, 0, (int32_t)params.size.x - 1, (int32_t)params.size.y - 1};
+    pScale         = params.scale;
+
+    pTilesX = (params.size.x + pTileSize - 1) / pTileSize;
+    pTilesY = (params.size.y + pTileSize - 1) / pTileSize;
+
+    pWindowName   = params.name;
+    pWindowTittle = params.name + " - FPS: 0";
+
+    pDrawingMode = params.mode;
+    pTextMode    = params.text_mode;
+
+    pVsync       = params.vsync;
+    pFullScreen  = params.fullscreen;
+    pClearBuffer = params.clear_buffer;
+    pBufferColor = params.buffer_color;
+
+    SetPersistence(params.persistence);
+
+    pHeadless      = params.headless;
+    pFixedTimestep = params.fixed_timestep;
+    pTargetFps     = params.target_fps;
+
+    pTiledRaster   = params.tiled_raster;
+    pRasterThreads = params.raster_threads;
+
+    pProfilerOverlay = params.profiler_overlay;
+    pTraceFile       = params.trace_file;
+
+    pOnLaunch      = params.on_launch;
+    pOnUpdate      = params.on_update;
+    pOnFixedUpdate = params.on_fixed_update;
+    pOnClose       = params.on_close;
+  }
+
+  Application::~Application() {
+    delete pFontSprite;
+    delete[] pBuffer;
+  }
+
+  // Every window runs its engine loop on the thread that launched it, while its events arrive on the platform service
+  void Application::pStartThread() {
+    std::shared_ptr<std::atomic<bool>> closed = pHasBeenClosed;
+
+    if (!pHeadless && pPlatform.CreateWindowPane(pWindowPos, pWindowSize, pFullScreen) != rcode::ok) {
+      return pSignalClosed(closed);
+    }
+
+    pThreadRunning = true;
+
+    if (!pHeadless) UpdateViewport();
+
+    pEngineThread();
+
+    if (!pHeadless) pPlatform.DestroyWindowPane();
+
+    pSignalClosed(closed);
+  }
+
+  void Application::pEngineThread() {
+    PIXEL_TRACE_THREAD("engine");
+
+    if (!pHeadless && pPlatform.CreateGraphics(pFullScreen, pVsync, pViewPos, pViewSize) == rcode::err) return;
+
+    delete[] pBuffer;
+
+    // Starting from the buffer colour, so that with persistence the first frames do not fade in from something else
+    pBuffer = new Pixel[pScreenSize.prod()];
+    Blend::Clear(pBuffer, pScreenSize.prod(), pClearBuffer ? pBufferColor : Pixel());
+
+    if (!pHeadless) {
+      pBufferId = pRenderer.CreateTexture(pScreenSize.x, pScreenSize.y);
+      pRenderer.UpdateTexture(pBufferId, pScreenSize.x, pScreenSize.y, pBuffer);
+    }
+
+    // Flagged as drawn so that the first frame clears, and uploads, the whole buffer
+    pDirtyTiles.assign(pTilesX * pTilesY, TILE_DRAWN);
+    pTileFade.assign(pTilesX * pTilesY, 0);
+    pTileOps.assign(pTilesX * pTilesY, TILE_KEEP);
+
+    pClock1 = std::chrono::steady_clock::now();
+    pClock2 = std::chrono::steady_clock::now();
+
+    if (pOnLaunch) {
+      if (pOnLaunch(*this) != rcode::ok) pThreadRunning = false;
+    }
+
+    pRasterizeCommands();
+
+    pNextFrame = std::chrono::steady_clock::now();
+
+    while (pThreadRunning) {
+      while (pThreadRunning) {
+        pClock2       = std::chrono::steady_clock::now();
+        pPhaseStart   = pClock2;
+        pElapsedTimer = pClock2 - pClock1;
+        pClock1       = pClock2;
+
+        // Frames last exactly one step when they are simulated, or when the fixed step drives on_update itself
+        bool simulated = pFixedTimestep > 0.0f && (pHeadless || !pOnFixedUpdate);
+        pElapsedTime   = simulated ? pFixedTimestep : pElapsedTimer.count();
+
+        pFrameTimer += pElapsedTime;
+        pFrameCount++;
+
+        if (pFrameTimer >= 1.0f) {
+          pFrameRate = pFrameCount;
+          pFrameTimer -= 1.0f;
+
+          pWindowTittle = pWindowName + " - FPS: " + std::to_string(pFrameRate);
+          if (!pHeadless) pPlatform.SetWindowTitle(pWindowTittle);
+
+          pFrameCount = 0;
+        }
+
+        pDrainInput();
+
+        pMarkPhase(Phase::INPUT);
+
+        if (pClearBuffer) pClearDrawnTiles();
+
+        pMarkPhase(Phase::CLEAR);
+
+        if (pOnFixedUpdate && pFixedTimestep > 0.0f) pFixedUpdate();
+
+        if (pOnUpdate) {
+          if (pOnUpdate(*this) != rcode::ok) pThreadRunning = false;
+        }
+
+        pRasterizeCommands();
+
+        if (pProfilerOverlay) pDrawProfilerOverlay();
+
+        pMarkPhase(Phase::UPDATE);
+
+        if (pHeadless) {
+          std::swap(pSpritesRecorded, pSpritesPending);
+          pSpritesPending.clear();
+
+          pMarkPhase(Phase::UPLOAD);
+          pMarkPhase(Phase::DECALS);
+          pMarkPhase(Phase::DISPLAY);
+
+        } else {
+          pRenderer.UpdateViewport(pViewPos, pViewSize);
+          pRenderer.ClearBuffer(Black, true);
+          pRenderer.PrepareDrawing();
+
+          pRenderer.ApplyTexture(pBufferId);
+          pUploadDirtyTiles();
+          pRenderer.DrawLayerQuad();
+
+          pMarkPhase(Phase::UPLOAD);
+
+          pRenderer.DrawDecalQuads(pSpritesPending);
+          pSpritesPending.clear();
+
+          for (uint32_t texture : pRetiredTextures) pRenderer.DeleteTexture(texture);
+          pRetiredTextures.clear();
+
+          pMarkPhase(Phase::DECALS);
+
+          pRenderer.DisplayFrame();
+
+          pMarkPhase(Phase::DISPLAY);
+        }
+
+        pPushProfile();
+
+        if (pTargetFps > 0 && !pHeadless) pWaitNextFrame();
+
+        if (pWantsToClose) {
+          pThreadRunning = false;
+          pWantsToClose  = false;
+        }
+      }
+
+      if (pOnClose) {
+        if (pOnClose(*this) != rcode::ok) pThreadRunning = true;
+      }
+    }
+
+    // The buffer itself outlives the loop, so the last frame stays readable through Frame()
+    if (!pHeadless) {
+      pRenderer.DeleteTexture(pBufferId);
+      pRenderer.DeleteBuffers();
+
+      for (auto& page : pAtlasPages) pRenderer.DeleteTexture(page.texture);
+      for (uint32_t texture : pRetiredTextures) pRenderer.DeleteTexture(texture);
+    }
+
+#ifdef PIXEL_TRACE
+    if (!pTraceFile.empty()) Tracer::Flush(pTraceFile);
+#endif
+  }
+
+  // Only touches the flag through the engine thread's own reference, as the application may be gone once it is set
+  void Application::pSignalClosed(const std::shared_ptr<std::atomic<bool>>& closed) {
+    closed->store(true);
+    closed->notify_all();
+  }
+
+  rcode Application::Launch(bool background) {
+    if (*pHasBeenClosed) return rcode::abort;
+
+    if (background) {
+      std::thread(&pixel::Application::pStartThread, this).detach();
+
+    } else {
+      pStartThread();
+    }
+
+    return rcode::ok;
+  }
+
+  // Expands the 1 bit font into the sprite used for decal text. Only done the first time text is drawn as decals, so
+  // applications that never do so skip both the 231 KB sheet and its texture
+  void Application::pCreateFont() {
+    pFontSprite = new Sprite(pGlyphWidth * pGlyphCount, pGlyphHeight);
+
+    for (uint32_t y = 0; y < pGlyphHeight; y++) {
+      for (uint32_t x = 0; x < pFontSprite->pSize.x; x++) {
+        uint32_t row = pFontRows[(x / pGlyphWidth) * pGlyphHeight + y];
+
+        pFontSprite->pBuffer[y * pFontSprite->pSize.x + x].n = row & (1u << (x % pGlyphWidth)) ? 0xFFFFFFFF : 0;
+      }
+    }
+
+    RegisterSprite(pFontSprite);
+    pBuildGlyphTable();
+  }
+
+  // Precomputes the UVs DrawPartialSprite would derive for each glyph. The font sprite only gets its final place once
+  // it is registered
+  void Application::pBuildGlyphTable() {
+    vf2d size = (vf2d)pFontSprite->pSize;
+
+    for (uint32_t g = 0; g < pGlyphCount; g++) {
+      vf2d spos(g * pGlyphWidth, 0);
+      vf2d ssize(pGlyphWidth, pGlyphHeight);
+
+      pGlyphs[g].uvtl = pFontSprite->pUvOffset + spos / size * pFontSprite->pUvScale;
+      pGlyphs[g].uvbr = pGlyphs[g].uvtl + (ssize / size * pFontSprite->pUvScale);
+    }
+  }
+
+  void Application::Close() { pWantsToClose = true; }
+
+  void Application::EnsureClosed() { pHasBeenClosed->wait(false); }
+
+  void Application::SetName(const std::string& name) { pWindowName = name; }
+
+  void Application::SetDrawingMode(pixel::DrawingMode mode) { pDrawingMode = mode; }
+
+  void Application::SetTiledRaster(bool enabled) {
+    if (!enabled) pRasterizeCommands();
+    pTiledRaster = enabled;
+  }
+
+  void Application::SetTextMode(pixel::TextMode mode) { pTextMode = mode; }
+
+  void Application::RegisterSprite(Sprite* spr) {
+    // Without a renderer sprites get no texture, decals drawn from them are only recorded
+    if (pHeadless) return;
+
+    // Re-registering a packed sprite of unchanged size only refreshes its pixels in place
+    if (spr->pAtlasEntry && spr->pAtlasEntry->size.x == spr->pSize.x && spr->pAtlasEntry->size.y == spr->pSize.y) {
+      pRenderer.ApplyTexture(spr->pBufferId);
+      pRenderer.UpdateTexture(spr->pBufferId, spr->pAtlasEntry->pos, spr);
+      return;
+    }
+
+    if (spr->pBufferId != 0xFFFFFFFF && !spr->pAtlasEntry) pRenderer.DeleteTexture(spr->pBufferId);
+
+    spr->pAtlasEntry.reset();
+    spr->pUvScale  = vf2d(1.0f, 1.0f);
+    spr->pUvOffset = vf2d(0.0f, 0.0f);
+
+    if (spr->pSize.x > pAtlasSpriteLimit || spr->pSize.y > pAtlasSpriteLimit) {
+      spr->pBufferId = pRenderer.CreateTexture(spr->pSize.x, spr->pSize.y);
+      pRenderer.UpdateTexture(spr->pBufferId, spr);
+      return;
+    }
+
+    for (uint32_t i = 0; i < pAtlasPages.size(); i++) {
+      vu2d pos;
+
+      if (pAtlasInsert(pAtlasPages[i], spr->pSize, pos)) return pAtlasPlace(spr, i, pos);
+    }
+
+    if (!pAtlasPages.empty()) {
+      uint32_t last = pAtlasPages.size() - 1;
+
+      for (uint32_t size = pAtlasPages[last].size * 2; size <= pAtlasMaxSize; size *= 2) {
+        if (pAtlasRepack(last, size, spr)) return;
+      }
+    }
+
+    pAtlasPages.emplace_back();
+
+    for (uint32_t size = pAtlasMinSize; size <= pAtlasMaxSize; size *= 2) {
+      if (pAtlasRepack(pAtlasPages.size() - 1, size, spr)) return;
+    }
+  }
+
+  // Bottom-left skyline placement: the sprite goes where its top edge ends lowest, preferring narrower segments on
+  // ties. Every sprite keeps pAtlasPadding pixels of gutter to its right and bottom
+  bool Application::pAtlasInsert(atlas_page_t& page, const vu2d& size, vu2d& pos) {
+    uint32_t width  = size.x + pAtlasPadding;
+    uint32_t height = size.y + pAtlasPadding;
+
+    uint32_t best_index = UINT32_MAX;
+    uint32_t best_top   = UINT32_MAX;
+    uint32_t best_width = UINT32_MAX;
+    uint32_t best_y     = 0;
+
+    for (uint32_t i = 0; i < page.skyline.size(); i++) {
+      if (page.skyline[i].x + width > page.size) break;
+
+      uint32_t y    = 0;
+      uint32_t left = width;
+
+      for (uint32_t j = i; left > 0; j++) {
+        y    = std::max(y, page.skyline[j].y);
+        left = left > page.skyline[j].width ? left - page.skyline[j].width : 0;
+      }
+
+      if (y + height > page.size) continue;
+
+      if (y + height < best_top || (y + height == best_top && page.skyline[i].width < best_width)) {
+        best_index = i;
+        best_top   = y + height;
+        best_width = page.skyline[i].width;
+        best_y     = y;
+      }
+    }
+
+    if (best_index == UINT32_MAX) return false;
+
+    pos = vu2d(page.skyline[best_index].x, best_y);
+
+    page.skyline.insert(page.skyline.begin() + best_index, {pos.x, best_top, width});
+
+    // Trim the segments now covered by the new one, then merge neighbours left at the same height
+    for (uint32_t i = best_index + 1; i < page.skyline.size();) {
+      skyline_t& segment = page.skyline[i];
+      uint32_t   end     = pos.x + width;
+
+      if (segment.x >= end) break;
+
+      uint32_t covered = std::min(end - segment.x, segment.width);
+
+      segment.x += covered;
+      segment.width -= covered;
+
+      if (segment.width > 0) break;
+
+      page.skyline.erase(page.skyline.begin() + i);
+    }
+
+    for (uint32_t i = 1; i < page.skyline.size();) {
+      if (page.skyline[i - 1].y == page.skyline[i].y) {
+        page.skyline[i - 1].width += page.skyline[i].width;
+        page.skyline.erase(page.skyline.begin() + i);
+      } else {
+        i++;
+      }
+    }
+
+    return true;
+  }
+
+  // Packs every live sprite of a page, plus the given one, into a fresh texture of the requested size. Placing them
+  // tallest first packs far tighter than the order they were registered in, and drops the space of destroyed sprites
+  bool Application::pAtlasRepack(uint32_t index, uint32_t size, Sprite* spr) {
+    atlas_page_t fresh;
+    fresh.size    = size;
+    fresh.skyline = {{0, 0, size}};
+
+    std::vector<Sprite*> sprites = {spr};
+
+    for (auto& weak : pAtlasPages[index].entries) {
+      if (auto entry = weak.lock()) sprites.push_back(entry->sprite);
+    }
+
+    std::stable_sort(sprites.begin(), sprites.end(), [](const Sprite* a, const Sprite* b) {
+      return a->pSize.y != b->pSize.y ? a->pSize.y > b->pSize.y : a->pSize.x > b->pSize.x;
+    });
+
+    std::vector<vu2d> positions(sprites.size());
+
+    for (uint32_t i = 0; i < sprites.size(); i++) {
+      if (!pAtlasInsert(fresh, sprites[i]->pSize, positions[i])) return false;
+    }
+
+    // Decals queued earlier this frame still point at the old texture, so it is only deleted once the frame is drawn
+    if (pAtlasPages[index].texture != 0xFFFFFFFF) pRetiredTextures.push_back(pAtlasPages[index].texture);
+
+    fresh.texture      = pRenderer.CreateTexture(size, size);
+    pAtlasPages[index] = std::move(fresh);
+
+    for (uint32_t i = 0; i < sprites.size(); i++) pAtlasPlace(sprites[i], index, positions[i]);
+
+    return true;
+  }
+
+  void Application::pAtlasPlace(Sprite* spr, uint32_t index, const vu2d& pos) {
+    atlas_page_t& page = pAtlasPages[index];
+
+    if (!spr->pAtlasEntry) spr->pAtlasEntry = std::make_shared<Sprite::atlas_entry_t>();
+
+    *spr->pAtlasEntry = {spr, index, pos, spr->pSize};
+    page.entries.push_back(spr->pAtlasEntry);
+
+    spr->pBufferId = page.texture;
+    spr->pUvOffset = (vf2d)pos / (float)page.size;
+    spr->pUvScale  = (vf2d)spr->pSize / (float)page.size;
+
+    pRenderer.ApplyTexture(page.texture);
+    pRenderer.UpdateTexture(page.texture, pos, spr);
+  }
+
+  void Application::DrawString(const vu2d& pos, std::string_view text, uint8_t size, const Pixel& color) {
+    if (pTextMode == TextMode::LAYER) return pDrawStringLayer(pos, text, size, color);
+    pDrawStringDecal(pos, text, size, color);
+  }
+
+  // Emits a whole string of glyph decals at once. The quad size and glyph UVs are the same for every character, so
+  // only the position changes from one quad to the next; spaces and characters missing from the font emit nothing
+  void Application::pDrawStringDecal(const vu2d& pos, std::string_view text, uint8_t size, const Pixel& color) {
+    if (!pFontSprite) pCreateFont();
+
+    vf2d scale((float)size / 32.0f, (float)size / 32.0f);
+    vf2d extent((2.0f * (float)pGlyphWidth * pInvScreenSize.x) * scale.x,
+                (2.0f * (float)pGlyphHeight * pInvScreenSize.y) * scale.y);
+
+    pSpritesPending.reserve(pSpritesPending.size() + text.size());
+
+    vu2d p = pos;
+
+    for (const char& c : text) {
+      if (c == '\n') {
+        p.y += size;
+        p.x = pos.x;
+
+        continue;
+      }
+
+      uint32_t g = (uint8_t)c - 32;
+
+      if (c != ' ' && g < pGlyphCount) {
+        SpriteRef& ref = pSpritesPending.emplace_back();
+        ref.pSprite    = pFontSprite;
+        ref.pTint      = color;
+
+        vf2d tl = {(float(p.x) * pInvScreenSize.x) * 2.0f - 1.0f,
+                   ((float(p.y) * pInvScreenSize.y) * 2.0f - 1.0f) * -1.0f};
+        vf2d br = {tl.x + extent.x, tl.y - extent.y};
+
+        ref.pPos[0] = {tl.x, tl.y};
+        ref.pPos[1] = {tl.x, br.y};
+        ref.pPos[2] = {br.x, br.y};
+        ref.pPos[3] = {br.x, tl.y};
+
+        const glyph_t& glyph = pGlyphs[g];
+
+        ref.pUv[0] = {glyph.uvtl.x, glyph.uvtl.y};
+        ref.pUv[1] = {glyph.uvtl.x, glyph.uvbr.y};
+        ref.pUv[2] = {glyph.uvbr.x, glyph.uvbr.y};
+        ref.pUv[3] = {glyph.uvbr.x, glyph.uvtl.y};
+      }
+
+      if (isascii(c) > 0) p.x += (float)size * 0.6f;
+    }
+  }
+
+  // Rasterizes the string straight into the layer. Each glyph row is one word of the 1 bit font, whose runs of set
+  // bits are found with a bit scan and filled as spans, scaled with nearest sampling of the cell
+  void Application::pDrawStringLayer(const vu2d& pos, std::string_view text, uint8_t size, const Pixel& color) {
+    vu2d p = pos;
+
+    for (const char& c : text) {
+      if (c == '\n') {
+        p.y += size;
+        p.x = pos.x;
+
+        continue;
+      }
+
+      uint32_t g = (uint8_t)c - 32;
+
+      if (c != ' ' && g < pGlyphCount) {
+        for (uint32_t dy = 0; dy < size; dy++) {
+          uint32_t bits = pFontRows[g * pGlyphHeight + (2 * dy + 1) * pGlyphHeight / (2 * size)];
+
+          while (bits) {
+            uint32_t start = std::countr_zero(bits);
+            uint32_t end   = start + std::countr_one(bits >> start);
+
+            bits &= end < 32 ? ~0u << end : 0u;
+
+            // Destination columns whose centre samples inside the [start, end) run of cell columns
+            int32_t x0 = (2 * start * size + pGlyphHeight - 1) / (2 * pGlyphHeight);
+            int32_t x1 = (2 * end * size + pGlyphHeight - 1) / (2 * pGlyphHeight);
+
+            if (x1 > x0) FillSpan(p.y + dy, p.x + x0, p.x + x1 - 1, color);
+          }
+        }
+      }
+
+      if (isascii(c) > 0) p.x += (float)size * 0.6f;
+    }
+  }
+
+  void Application::Draw(const vu2d& pos, const Pixel& pixel) {
+    if (pTiledRaster) return pSubmit({.type = command_t::POINT, .pixel = pixel, .pos = {pos}});
+    if (pos.x >= pScreenSize.x || pos.y >= pScreenSize.y) return;
+
+    pDispatch(pDrawingMode, pixel, [&](auto mode) {
+      pDirtyTiles[(pos.y / pTileSize) * pTilesX + pos.x / pTileSize] = TILE_DRAWN | TILE_UPLOAD;
+      pPlot<decltype(mode)::value>(pScreenRect, pos.x, pos.y, pixel);
+    });
+  }
+
+  bool Application::ClipSpan(const rect_t& clip, int32_t& y, int32_t& x0, int32_t& x1) const {
+    if (x0 > x1) std::swap(x0, x1);
+
+    if (y < clip.y0 || y > clip.y1) return false;
+    if (x1 < clip.x0 || x0 > clip.x1) return false;
+
+    x0 = std::max(x0, clip.x0);
+    x1 = std::min(x1, clip.x1);
+
+    return true;
+  }
+
+  // Resolves the drawing mode once per primitive, so that the rasterizer inner loops are compiled without a mode
+  // branch. Opaque pixels blend to themselves and take the NO_ALPHA path, and under MASK translucent primitives are
+  // dropped whole
+  template <typename F>
+  void Application::pDispatch(pixel::DrawingMode mode, const Pixel& pixel, F&& rasterize) {
+    if (pixel.v.a == 255 || mode == DrawingMode::NO_ALPHA) {
+      rasterize(std::integral_constant<pixel::DrawingMode, pixel::DrawingMode::NO_ALPHA>());
+
+    } else if (mode == DrawingMode::FULL_ALPHA) {
+      rasterize(std::integral_constant<pixel::DrawingMode, pixel::DrawingMode::FULL_ALPHA>());
+    }
+  }
+
+  template <pixel::DrawingMode M>
+  void Application::pPlot(const rect_t& clip, int32_t x, int32_t y, const Pixel& pixel) {
+    if (x < clip.x0 || x > clip.x1 || y < clip.y0 || y > clip.y1) return;
+
+    Pixel& d = pBuffer[y * pScreenSize.x + x];
+
+    if constexpr (M == pixel::DrawingMode::FULL_ALPHA) {
+      d = Blend::Over(pixel, d);
+    } else {
+      d = pixel;
+    }
+  }
+
+  template <pixel::DrawingMode M>
+  void Application::pSpan(const rect_t& clip, int32_t y, int32_t x0, int32_t x1, const Pixel& pixel) {
+    if (!ClipSpan(clip, y, x0, x1)) return;
+
+    Pixel* row = pBuffer + y * pScreenSize.x;
+
+    if constexpr (M == pixel::DrawingMode::FULL_ALPHA) {
+      Blend::Fill(row + x0, x1 - x0 + 1, pixel);
+    } else {
+      std::fill(row + x0, row + x1 + 1, pixel);
+    }
+  }
+
+  // Fills the pixels [x0, x1] of row y, clipping the run once against the screen instead of once per pixel
+  void Application::FillSpan(int32_t y, int32_t x0, int32_t x1, const Pixel& pixel) {
+    pSubmit({.type = command_t::SPAN, .pixel = pixel, .pos = {vi2d(x0, y), vi2d(x1, y)}});
+  }
+
+  // Alpha blends the pixels [x0, x1] of row y regardless of the current drawing mode
+  void Application::BlendSpan(int32_t y, int32_t x0, int32_t x1, const Pixel& pixel) {
+    pSubmit({.type = command_t::SPAN, .pixel = pixel, .pos = {vi2d(x0, y), vi2d(x1, y)}}, DrawingMode::FULL_ALPHA);
+  }
+
+  void Application::DrawLine(const vu2d& pos1, const vu2d& pos2, const Pixel& pixel) {
+    pSubmit({.type = command_t::LINE, .pixel = pixel, .pos = {pos1, pos2}});
+  }
+
+  // Bresenham line walk. Only the steps whose major axis coordinate lies inside the clip rect are visited, the minor
+  // axis position and error term at the first of them are computed in closed form, so a line crossing many tiles is
+  // not walked in full by each one of them
+  template <pixel::DrawingMode M>
+  void Application::pDrawLine(const rect_t& clip, const vu2d& pos1, const vu2d& pos2, const Pixel& pixel) {
+    int32_t x, y, dx, dy, dx1, dy1, px, py, xe, ye, m, s;
+    int64_t k, k0, k1;
+    dx = pos2.x - pos1.x;
+    dy = pos2.y - pos1.y;
+
+    if (dx == 0) {
+      y  = std::max(std::min((int32_t)pos1.y, (int32_t)pos2.y), clip.y0);
+      ye = std::min(std::max((int32_t)pos1.y, (int32_t)pos2.y), clip.y1);
+
+      for (; y <= ye; y++) pPlot<M>(clip, pos1.x, y, pixel);
+      return;
+    }
+
+    if (dy == 0) {
+      pSpan<M>(clip, pos1.y, pos1.x, pos2.x, pixel);
+      return;
+    }
+
+    dx1 = std::abs(dx);
+    dy1 = std::abs(dy);
+    s   = ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) ? 1 : -1;
+
+    if (dy1 <= dx1) {
+      if (dx >= 0) {
+        x  = pos1.x;
+        y  = pos1.y;
+        xe = pos2.x;
+      } else {
+        x  = pos2.x;
+        y  = pos2.y;
+        xe = pos1.x;
+      }
+
+      k0 = std::max<int64_t>(0, (int64_t)clip.x0 - x);
+      k1 = std::min<int64_t>((int64_t)xe - x, (int64_t)clip.x1 - x);
+      if (k0 > k1) return;
+
+      m  = (2 * k0 * dy1 + dx1) / (2 * (int64_t)dx1);
+      px = 2 * dy1 - dx1 + 2 * k0 * dy1 - 2 * (int64_t)m * dx1;
+      x += k0;
+      y += s * m;
+
+      pPlot<M>(clip, x, y, pixel);
+
+      for (k = k0; k < k1; k++) {
+        x = x + 1;
+
+        if (px < 0)
+          px = px + 2 * dy1;
+        else {
+          y  = y + s;
+          px = px + 2 * (dy1 - dx1);
+        }
+
+        pPlot<M>(clip, x, y, pixel);
+      }
+
+    } else {
+      if (dy >= 0) {
+        x  = pos1.x;
+        y  = pos1.y;
+        ye = pos2.y;
+      } else {
+        x  = pos2.x;
+        y  = pos2.y;
+        ye = pos1.y;
+      }
+
+      k0 = std::max<int64_t>(0, (int64_t)clip.y0 - y);
+      k1 = std::min<int64_t>((int64_t)ye - y, (int64_t)clip.y1 - y);
+      if (k0 > k1) return;
+
+      m  = (2 * k0 * dx1 + dy1 - 1) / (2 * (int64_t)dy1);
+      py = 2 * dx1 - dy1 + 2 * k0 * dx1 - 2 * (int64_t)m * dy1;
+      y += k0;
+      x += s * m;
+
+      pPlot<M>(clip, x, y, pixel);
+
+      for (k = k0; k < k1; k++) {
+        y = y + 1;
+
+        if (py <= 0) {
+          py = py + 2 * dx1;
+        } else {
+          x  = x + s;
+          py = py + 2 * (dx1 - dy1);
+        }
+
+        pPlot<M>(clip, x, y, pixel);
+      }
+    }
+  }
+
+  void Application::DrawCircle(const vu2d& pos, uint32_t radius, const Pixel& pixel) {
+    pSubmit({.type = command_t::CIRCLE, .pixel = pixel, .pos = {pos}, .radius = radius});
+  }
+
+  template <pixel::DrawingMode M>
+  void Application::pDrawCircle(const rect_t& clip, const vu2d& pos, uint32_t radius, const Pixel& pixel) {
+    uint32_t x0 = 0;
+    uint32_t y0 = radius;
+    int      d  = 3 - 2 * radius;
+
+    if (!radius) return;
+
+    while (y0 >= x0) {
+      pPlot<M>(clip, pos.x + x0, pos.y - y0, pixel);
+      pPlot<M>(clip, pos.x + y0, pos.y - x0, pixel);
+      pPlot<M>(clip, pos.x + y0, pos.y + x0, pixel);
+      pPlot<M>(clip, pos.x + x0, pos.y + y0, pixel);
+      pPlot<M>(clip, pos.x - x0, pos.y + y0, pixel);
+      pPlot<M>(clip, pos.x - y0, pos.y + x0, pixel);
+      pPlot<M>(clip, pos.x - y0, pos.y - x0, pixel);
+      pPlot<M>(clip, pos.x - x0, pos.y - y0, pixel);
+
+      if (d < 0)
+        d += 4 * x0++ + 6;
+      else
+        d += 4 * (x0++ - y0--) + 10;
+    }
+  }
+
+  void Application::FillCircle(const vu2d& pos, uint32_t radius, const Pixel& pixel) {
+    pSubmit({.type = command_t::FILL_CIRCLE, .pixel = pixel, .pos = {pos}, .radius = radius});
+  }
+
+  template <pixel::DrawingMode M>
+  void Application::pFillCircle(const rect_t& clip, const vu2d& pos, uint32_t radius, const Pixel& pixel) {
+    int x0 = 0;
+    int y0 = radius;
+    int d  = 3 - 2 * radius;
+
+    if (!radius) return;
+
+    while (y0 >= x0) {
+      pSpan<M>(clip, pos.y - y0, pos.x - x0, pos.x + x0, pixel);
+      pSpan<M>(clip, pos.y - x0, pos.x - y0, pos.x + y0, pixel);
+      pSpan<M>(clip, pos.y + y0, pos.x - x0, pos.x + x0, pixel);
+      pSpan<M>(clip, pos.y + x0, pos.x - y0, pos.x + y0, pixel);
+
+      if (d < 0)
+        d += 4 * x0++ + 6;
+      else
+        d += 4 * (x0++ - y0--) + 10;
+    }
+  }
+
+  void Application::DrawRect(const vu2d& pos1, const vu2d& pos2, const Pixel& pixel) {
+    DrawLine(vu2d(pos1.x, pos1.y), vu2d(pos1.y, pos2.x), pixel);
+    DrawLine(vu2d(pos1.y, pos2.x), vu2d(pos2.x, pos2.y), pixel);
+    DrawLine(vu2d(pos2.x, pos2.y), vu2d(pos2.y, pos1.x), pixel);
+    DrawLine(vu2d(pos2.y, pos1.x), vu2d(pos1.x, pos1.y), pixel);
+  }
+
+  void Application::FillRect(const vu2d& pos1, const vu2d& pos2, const Pixel& pixel) {
+    pSubmit({.type = command_t::FILL_RECT, .pixel = pixel, .pos = {pos1, pos2}});
+  }
+
+  template <pixel::DrawingMode M>
+  void Application::pFillRect(const rect_t& clip, const vu2d& pos1, const vu2d& pos2, const Pixel& pixel) {
+    // Done in unsigned arithmetic, so that a rect reaching past INT32_MAX is not mistaken for a negative one
+    if (std::min(pos1.x, pos2.x) > (uint32_t)clip.x1) return;
+    if (std::min(pos1.y, pos2.y) > (uint32_t)clip.y1) return;
+
+    int32_t xs = std::min(pos1.x, pos2.x);
+    int32_t xe = std::min(std::max(pos1.x, pos2.x), (uint32_t)clip.x1);
+    int32_t ys = std::max((int32_t)std::min(pos1.y, pos2.y), clip.y0);
+    int32_t ye = std::min(std::max(pos1.y, pos2.y), (uint32_t)clip.y1);
+
+    for (int32_t y = ys; y <= ye; y++) {
+      pSpan<M>(clip, y, xs, xe, pixel);
+    }
+  }
+
+  void Application::DrawTriangle(const vu2d& pos1, const vu2d& pos2, const vu2d& pos3, const Pixel& pixel) {
+    DrawLine(vu2d(pos1.x, pos1.y), vu2d(pos2.x, pos2.y), pixel);
+    DrawLine(vu2d(pos2.x, pos2.y), vu2d(pos3.x, pos3.y), pixel);
+    DrawLine(vu2d(pos3.x, pos3.y), vu2d(pos1.x, pos1.y), pixel);
+  }
+
+  void Application::FillTriangle(const vu2d& pos1, const vu2d& pos2, const vu2d& pos3, const Pixel& pixel) {
+    pSubmit({.type = command_t::FILL_TRIANGLE, .pixel = pixel, .pos = {pos1, pos2, pos3}});
+  }
+
+  template <pixel::DrawingMode M>
+  void Application::pFillTriangle(const rect_t& clip,
+                                   const vu2d&   pos1,
+                                   const vu2d&   pos2,
+                                   const vu2d&   pos3,
+                                   const Pixel&  pixel) {
+    vu2d p1 = pos1;
+    vu2d p2 = pos2;
+    vu2d p3 = pos3;
+
+    int32_t t1x, t2x, y, minx, maxx, t1xp, t2xp;
+    int32_t signx1, signx2, dx1, dy1, dx2, dy2;
+    int32_t e1, e2;
+
+    bool changed1 = false;
+    bool changed2 = false;
+
+    if (p1.y > p2.y) {
+      std::swap(p1.y, p2.y);
+      std::swap(p1.x, p2.x);
+    }
+    if (p1.y > p3.y) {
+      std::swap(p1.y, p3.y);
+      std::swap(p1.x, p3.x);
+    }
+    if (p2.y > p3.y) {
+      std::swap(p2.y, p3.y);
+      std::swap(p2.x, p3.x);
+    }
+
+    t1x = t2x = p1.x;
+    y         = p1.y;
+    dx1       = (int)(p2.x - p1.x);
+    if (dx1 < 0) {
+      dx1    = -dx1;
+      signx1 = -1;
+    } else
+      signx1 = 1;
+    dy1 = (int)(p2.y - p1.y);
+
+    dx2 = (int)(p3.x - p1.x);
+    if (dx2 < 0) {
+      dx2    = -dx2;
+      signx2 = -1;
+    } else
+      signx2 = 1;
+    dy2 = (int)(p3.y - p1.y);
+
+    if (dy1 > dx1) {
+      std::swap(dx1, dy1);
+      changed1 = true;
+    }
+    if (dy2 > dx2) {
+      std::swap(dy2, dx2);
+      changed2 = true;
+    }
+
+    e2 = (int)(dx2 >> 1);
+
+    if (p1.y == p2.y) goto next;
+    e1 = (int)(dx1 >> 1);
 
     for (int i = 0; i < dx1;) {
       t1xp = 0;
@@ -1471,258 +4160,1016 @@ namespace pixel {
         maxx = t1x;
       }
 
-      while (i < dx1) {
-        i++;
-        e1 += dy1;
+      while (i < dx1) {
+        i++;
+        e1 += dy1;
+
+        while (e1 >= dx1) {
+          e1 -= dx1;
+
+          if (changed1)
+            t1xp = signx1;
+          else
+            goto next1;
+        }
+
+        if (changed1)
+          break;
+        else
+          t1x += signx1;
+      }
+
+    next1:
+
+      while (1) {
+        e2 += dy2;
+
+        while (e2 >= dx2) {
+          e2 -= dx2;
+
+          if (changed2)
+            t2xp = signx2;
+          else
+            goto next2;
+        }
+
+        if (changed2)
+          break;
+        else
+          t2x += signx2;
+      }
+
+    next2:
+
+      if (minx > t1x) minx = t1x;
+      if (minx > t2x) minx = t2x;
+      if (maxx < t1x) maxx = t1x;
+      if (maxx < t2x) maxx = t2x;
+
+      if (y > clip.y1) return;
+      pSpan<M>(clip, y, minx, maxx, pixel);
+
+      if (!changed1) t1x += signx1;
+      t1x += t1xp;
+
+      if (!changed2) t2x += signx2;
+      t2x += t2xp;
+
+      y += 1;
+      if (y == (int32_t)p2.y) break;
+    }
+
+  next:
+
+    dx1 = (int)(p3.x - p2.x);
+    if (dx1 < 0) {
+      dx1    = -dx1;
+      signx1 = -1;
+    } else
+      signx1 = 1;
+    dy1 = (int)(p3.y - p2.y);
+
+    t1x = p2.x;
+
+    if (dy1 > dx1) {
+      std::swap(dy1, dx1);
+      changed1 = true;
+    } else
+      changed1 = false;
+
+    e1 = (int)(dx1 >> 1);
+
+    for (int i = 0; i <= dx1; i++) {
+      t1xp = 0;
+      t2xp = 0;
+
+      if (t1x < t2x) {
+        minx = t1x;
+        maxx = t2x;
+      } else {
+        minx = t2x;
+        maxx = t1x;
+      }
+
+      while (i < dx1) {
+        e1 += dy1;
+
+        while (e1 >= dx1) {
+          e1 -= dx1;
+          if (changed1) {
+            t1xp = signx1;
+            break;
+          } else
+            goto next3;
+        }
+
+        if (changed1)
+          break;
+        else
+          t1x += signx1;
+        if (i < dx1) i++;
+      }
+
+    next3:
+
+      while (t2x != (int32_t)p3.x) {
+        e2 += dy2;
+
+        while (e2 >= dx2) {
+          e2 -= dx2;
+          if (changed2)
+            t2xp = signx2;
+          else
+            goto next4;
+        }
+
+        if (changed2)
+          break;
+        else
+          t2x += signx2;
+      }
+
+    next4:
+
+      if (minx > t1x) minx = t1x;
+      if (minx > t2x) minx = t2x;
+      if (maxx < t1x) maxx = t1x;
+      if (maxx < t2x) maxx = t2x;
+
+      if (y > clip.y1) return;
+      pSpan<M>(clip, y, minx, maxx, pixel);
+
+      if (!changed1) t1x += signx1;
+      t1x += t1xp;
+
+      if (!changed2) t2x += signx2;
+      t2x += t2xp;
+
+      y += 1;
+      if (y > (int32_t)p3.y) return;
+    }
+  }
+
+  // Particles are plotted as single pixels in one pass over their arrays, instead of one command per particle, so
+  // commands recorded before are rasterized first to keep them underneath
+  void Application::DrawParticles(const ParticleSystem& particles) {
+    if (pTiledRaster) pRasterizeCommands();
+
+    switch (pDrawingMode) {
+      case pixel::DrawingMode::NO_ALPHA: pDrawParticles<pixel::DrawingMode::NO_ALPHA>(particles); break;
+      case pixel::DrawingMode::FULL_ALPHA: pDrawParticles<pixel::DrawingMode::FULL_ALPHA>(particles); break;
+      case pixel::DrawingMode::MASK: pDrawParticles<pixel::DrawingMode::MASK>(particles); break;
+    }
+  }
+
+  template <pixel::DrawingMode M>
+  void Application::pDrawParticles(const ParticleSystem& particles) {
+    const float* x      = particles.X();
+    const float* y      = particles.Y();
+    const Pixel* colors = particles.Colors();
+
+    float w = pScreenSize.x;
+    float h = pScreenSize.y;
+
+    for (uint32_t i = 0; i < particles.Size(); i++) {
+      // Written so that NaN positions fail the test too
+      if (!(x[i] >= 0.0f && x[i] < w && y[i] >= 0.0f && y[i] < h)) continue;
+
+      uint32_t px = x[i];
+      uint32_t py = y[i];
+
+      const Pixel& color = colors[i];
+      Pixel&       d     = pBuffer[py * pScreenSize.x + px];
+
+      if (color.v.a == 255 || M == pixel::DrawingMode::NO_ALPHA) {
+        d = color;
+      } else if (M == pixel::DrawingMode::FULL_ALPHA) {
+        d = Blend::Over(color, d);
+      } else {
+        continue;
+      }
+
+      pDirtyTiles[(py / pTileSize) * pTilesX + px / pTileSize] = TILE_DRAWN | TILE_UPLOAD;
+    }
+  }
+
+  void Application::pSubmit(command_t command) { pSubmit(command, pDrawingMode); }
+
+  // Entry point of every primitive except single pixels. The drawing mode is resolved here, as it may change before a
+  // queued command is drawn, and the clipped bounding box is used both to flag dirty tiles and to bin the command
+  void Application::pSubmit(command_t command, pixel::DrawingMode mode) {
+    pDispatch(mode, command.pixel, [&](auto resolved) {
+      command.mode = decltype(resolved)::value;
+
+      int64_t x0, y0, x1, y1;
+
+      switch (command.type) {
+        case command_t::CIRCLE:
+        case command_t::FILL_CIRCLE:
+          x0 = (int64_t)(uint32_t)command.pos[0].x - command.radius;
+          y0 = (int64_t)(uint32_t)command.pos[0].y - command.radius;
+          x1 = (int64_t)(uint32_t)command.pos[0].x + command.radius;
+          y1 = (int64_t)(uint32_t)command.pos[0].y + command.radius;
+          break;
+
+        case command_t::SPAN:
+          x0 = std::min(command.pos[0].x, command.pos[1].x);
+          x1 = std::max(command.pos[0].x, command.pos[1].x);
+          y0 = y1 = command.pos[0].y;
+          break;
+
+        default:
+          uint8_t n = command.type == command_t::FILL_TRIANGLE ? 3 : command.type == command_t::POINT ? 1 : 2;
+
+          x0 = x1 = (uint32_t)command.pos[0].x;
+          y0 = y1 = (uint32_t)command.pos[0].y;
+
+          for (uint8_t i = 1; i < n; i++) {
+            x0 = std::min<int64_t>(x0, (uint32_t)command.pos[i].x);
+            y0 = std::min<int64_t>(y0, (uint32_t)command.pos[i].y);
+            x1 = std::max<int64_t>(x1, (uint32_t)command.pos[i].x);
+            y1 = std::max<int64_t>(y1, (uint32_t)command.pos[i].y);
+          }
+          break;
+      }
+
+      if (x1 < pScreenRect.x0 || y1 < pScreenRect.y0 || x0 > pScreenRect.x1 || y0 > pScreenRect.y1) return;
+
+      command.bounds = {(int32_t)std::max<int64_t>(x0, pScreenRect.x0),
+                        (int32_t)std::max<int64_t>(y0, pScreenRect.y0),
+                        (int32_t)std::min<int64_t>(x1, pScreenRect.x1),
+                        (int32_t)std::min<int64_t>(y1, pScreenRect.y1)};
+
+      pMarkDirty(command.bounds);
+
+      if (pTiledRaster) {
+        pCommands.push_back(command);
+      } else {
+        pExecute(command, pScreenRect);
+      }
+    });
+  }
+
+  void Application::pExecute(const command_t& command, const rect_t& clip) {
+    auto execute = [&](auto mode) {
+      constexpr pixel::DrawingMode M = decltype(mode)::value;
+
+      const command_t& c = command;
+
+      switch (c.type) {
+        case command_t::POINT:
+          pPlot<M>(clip, c.pos[0].x, c.pos[0].y, c.pixel);
+          break;
+        case command_t::SPAN:
+          pSpan<M>(clip, c.pos[0].y, c.pos[0].x, c.pos[1].x, c.pixel);
+          break;
+        case command_t::LINE:
+          pDrawLine<M>(clip, c.pos[0], c.pos[1], c.pixel);
+          break;
+        case command_t::CIRCLE:
+          pDrawCircle<M>(clip, c.pos[0], c.radius, c.pixel);
+          break;
+        case command_t::FILL_CIRCLE:
+          pFillCircle<M>(clip, c.pos[0], c.radius, c.pixel);
+          break;
+        case command_t::FILL_RECT:
+          pFillRect<M>(clip, c.pos[0], c.pos[1], c.pixel);
+          break;
+        case command_t::FILL_TRIANGLE:
+          pFillTriangle<M>(clip, c.pos[0], c.pos[1], c.pos[2], c.pixel);
+          break;
+      }
+    };
+
+    if (command.mode == DrawingMode::FULL_ALPHA) {
+      execute(std::integral_constant<pixel::DrawingMode, pixel::DrawingMode::FULL_ALPHA>());
+    } else {
+      execute(std::integral_constant<pixel::DrawingMode, pixel::DrawingMode::NO_ALPHA>());
+    }
+  }
+
+  // Bins the queued primitives into screen tiles and rasterizes the tiles on the worker pool. A tile is only ever
+  // touched by the thread that owns it and its primitives are drawn in submission order, so no locking is needed and
+  // the result is the same as drawing everything on a single thread
+  void Application::pRasterizeCommands() {
+    if (pCommands.empty()) return;
+
+    pTileBins.resize(pTilesX * pTilesY);
+    for (auto& bin : pTileBins) bin.clear();
+
+    for (uint32_t i = 0; i < pCommands.size(); i++) {
+      const rect_t& b = pCommands[i].bounds;
+
+      for (uint32_t y = b.y0 / pTileSize; y <= b.y1 / pTileSize; y++) {
+        for (uint32_t x = b.x0 / pTileSize; x <= b.x1 / pTileSize; x++) {
+          pTileBins[y * pTilesX + x].push_back(i);
+        }
+      }
+    }
+
+    pRasterJobs().ParallelFor(
+        pTilesX * pTilesY,
+        [&](uint32_t tile) {
+          rect_t clip;
+          clip.x0 = (tile % pTilesX) * pTileSize;
+          clip.y0 = (tile / pTilesX) * pTileSize;
+          clip.x1 = std::min<int32_t>(clip.x0 + pTileSize - 1, pScreenRect.x1);
+          clip.y1 = std::min<int32_t>(clip.y0 + pTileSize - 1, pScreenRect.y1);
+
+          for (uint32_t i : pTileBins[tile]) pExecute(pCommands[i], clip);
+        },
+        1);
+
+    pCommands.clear();
+  }
+
+  // Tiles, large clears and large blits run on the shared job system, unless a thread count was asked for
+  JobSystem& Application::pRasterJobs() {
+    if (!pRasterPool && pRasterThreads) pRasterPool = std::make_unique<JobSystem>(pRasterThreads);
+    return pRasterPool ? *pRasterPool : JobSystem::Shared();
+  }
+
+  void Application::pMarkDirty(const rect_t& rect) {
+    for (uint32_t y = rect.y0 / pTileSize; y <= rect.y1 / pTileSize; y++) {
+      for (uint32_t x = rect.x0 / pTileSize; x <= rect.x1 / pTileSize; x++) {
+        pDirtyTiles[y * pTilesX + x] = TILE_DRAWN | TILE_UPLOAD;
+      }
+    }
+  }
+
+  // Only the tiles drawn to last frame, or still fading out with persistence, can differ from the buffer colour, so
+  // those are the only ones cleared or faded. They are kept flagged for upload, as they changed even if nothing is
+  // drawn on them this frame. Runs of tiles in the same state are handled together, as one span across whole rows
+  void Application::pClearDrawnTiles() {
+    for (uint32_t t = 0; t < pTilesX * pTilesY; t++) {
+      if (pDirtyTiles[t] & TILE_DRAWN) pTileFade[t] = pFadeFrames ? pFadeFrames : 1;
+
+      if (pTileFade[t] == 0) {
+        pTileOps[t] = TILE_KEEP;
+        continue;
+      }
+
+      pTileOps[t]    = pFadeFrames ? TILE_FADE : TILE_CLEAR;
+      pDirtyTiles[t] = TILE_UPLOAD;
+      pTileFade[t]   = pFadeFrames ? pTileFade[t] - 1 : 0;
+    }
+
+    bool large = pScreenSize.prod() >= pLargeCanvas;
+
+    auto row = [&](uint32_t ty) {
+      uint32_t y0 = ty * pTileSize;
+      uint32_t y1 = std::min(y0 + pTileSize, pScreenSize.y);
+
+      const uint8_t* ops = &pTileOps[ty * pTilesX];
+
+      for (uint32_t tx = 0, end; tx < pTilesX; tx = end) {
+        for (end = tx + 1; end < pTilesX && ops[end] == ops[tx];) end++;
+
+        if (ops[tx] == TILE_KEEP) continue;
+
+        uint32_t x0 = tx * pTileSize;
+        uint32_t x1 = std::min(end * pTileSize, pScreenSize.x);
+
+        bool     whole = x1 - x0 == pScreenSize.x;
+        uint32_t rows  = whole ? 1 : y1 - y0;
+        uint32_t span  = whole ? pScreenSize.x * (y1 - y0) : x1 - x0;
+
+        for (uint32_t y = y0; y < y0 + rows; y++) {
+          Pixel* dst = pBuffer + y * pScreenSize.x + x0;
+
+          if (ops[tx] == TILE_FADE) {
+            Blend::Fade(dst, span, pBufferColor, pFadeKeep);
+          } else {
+            Blend::Clear(dst, span, pBufferColor, large);
+          }
+        }
+      }
+    };
+
+    if (large) {
+      pRasterJobs().ParallelFor(pTilesY, row, 1);
+    } else {
+      for (uint32_t ty = 0; ty < pTilesY; ty++) row(ty);
+    }
+  }
+
+  // Uploads each horizontal run of tiles flagged for upload as a single region. Nothing is sent to the GPU on frames
+  // where the buffer did not change
+  void Application::pUploadDirtyTiles() {
+    for (uint32_t ty = 0; ty < pTilesY; ty++) {
+      uint8_t* row = pDirtyTiles.data() + ty * pTilesX;
+
+      for (uint32_t tx = 0; tx < pTilesX;) {
+        if (!(row[tx] & TILE_UPLOAD)) {
+          tx++;
+          continue;
+        }
+
+        uint32_t start = tx;
+
+        for (; tx < pTilesX && (row[tx] & TILE_UPLOAD); tx++) {
+          row[tx] &= ~TILE_UPLOAD;
+        }
+
+        vu2d pos(start * pTileSize, ty * pTileSize);
+        vu2d end(std::min(tx * pTileSize, pScreenSize.x), std::min((ty + 1) * pTileSize, pScreenSize.y));
+
+        pUploadRegions.emplace_back(pos, end - pos);
+      }
+    }
+
+    pRenderer.UpdateTexture(pBufferId, pScreenSize, pUploadRegions, pBuffer);
+    pUploadRegions.clear();
+  }
+
+  void Application::DrawSprite(const vu2d& pos, Sprite* spr, const vf2d& scale, const Pixel& tint) {
+    SpriteRef spr_ref;
+    spr_ref.pSprite = spr;
+
+    vf2d newpos = {(float(pos.x) * pInvScreenSize.x) * 2.0f - 1.0f,
+                   ((float(pos.y) * pInvScreenSize.y) * 2.0f - 1.0f) * -1.0f};
+
+    vf2d newsize = {newpos.x + (2.0f * float(spr->pSize.x) * pInvScreenSize.x) * scale.x,
+                    newpos.y - (2.0f * float(spr->pSize.y) * pInvScreenSize.y) * scale.y};
+
+    spr_ref.pTint = tint;
+
+    spr_ref.pPos[0] = {newpos.x, newpos.y};
+    spr_ref.pPos[1] = {newpos.x, newsize.y};
+    spr_ref.pPos[2] = {newsize.x, newsize.y};
+    spr_ref.pPos[3] = {newsize.x, newpos.y};
+
+    vf2d uvtl = spr->pUvOffset;
+    vf2d uvbr = spr->pUvOffset + spr->pUvScale;
+
+    spr_ref.pUv[0] = {uvtl.x, uvtl.y};
+    spr_ref.pUv[1] = {uvtl.x, uvbr.y};
+    spr_ref.pUv[2] = {uvbr.x, uvbr.y};
+    spr_ref.pUv[3] = {uvbr.x, uvtl.y};
+
+    pSpritesPending.push_back(spr_ref);
+  }
+
+  void Application::DrawPartialSprite(const vu2d&  pos,
+                                      const vu2d&  spos,
+                                      const vu2d&  ssize,
+                                      Sprite*      spr,
+                                      const vf2d&  scale,
+                                      const Pixel& tint) {
+    SpriteRef spr_ref;
+    spr_ref.pSprite = spr;
+
+    vf2d newpos = {(float(pos.x) * pInvScreenSize.x) * 2.0f - 1.0f,
+                   ((float(pos.y) * pInvScreenSize.y) * 2.0f - 1.0f) * -1.0f};
+
+    vf2d newsize = {newpos.x + (2.0f * (float)ssize.x * pInvScreenSize.x) * scale.x,
+                    newpos.y - (2.0f * (float)ssize.y * pInvScreenSize.y) * scale.y};
+
+    spr_ref.pTint = tint;
+
+    spr_ref.pPos[0] = {newpos.x, newpos.y};
+    spr_ref.pPos[1] = {newpos.x, newsize.y};
+    spr_ref.pPos[2] = {newsize.x, newsize.y};
+    spr_ref.pPos[3] = {newsize.x, newpos.y};
+
+    vf2d uvtl = spr->pUvOffset + (vf2d)spos / (vf2d)spr->pSize * spr->pUvScale;
+    vf2d uvbr = uvtl + ((vf2d)ssize / (vf2d)spr->pSize * spr->pUvScale);
+
+    spr_ref.pUv[0] = {uvtl.x, uvtl.y};
+    spr_ref.pUv[1] = {uvtl.x, uvbr.y};
+    spr_ref.pUv[2] = {uvbr.x, uvbr.y};
+    spr_ref.pUv[3] = {uvbr.x, uvtl.y};
+
+    pSpritesPending.push_back(spr_ref);
+  }
+
+  void Application::BlitSprite(const vi2d&       pos,
+                               Sprite*           spr,
+                               const vf2d&       scale,
+                               const Pixel&      tint,
+                               pixel::FilterMode filter) {
+    BlitPartialSprite(pos, vu2d(0, 0), spr->pSize, spr, scale, tint, filter);
+  }
+
+  // Everything that only depends on the blit as a whole, clipping and the column tables, is worked out once here. Like
+  // particles, blits are drawn right away, so commands recorded before are rasterized first to keep them underneath
+  void Application::BlitPartialSprite(const vi2d&       pos,
+                                      const vu2d&       spos,
+                                      const vu2d&       ssize,
+                                      Sprite*           spr,
+                                      const vf2d&       scale,
+                                      const Pixel&      tint,
+                                      pixel::FilterMode filter) {
+    if (!spr->pBuffer || spos.x >= spr->pSize.x || spos.y >= spr->pSize.y) return;
+
+    // Written so that NaN scales fail the test too
+    if (!(scale.x > 0.0f && scale.y > 0.0f)) return;
+
+    vu2d size(std::min(ssize.x, spr->pSize.x - spos.x), std::min(ssize.y, spr->pSize.y - spos.y));
+
+    int64_t w = std::min<double>((double)size.x * scale.x, INT32_MAX);
+    int64_t h = std::min<double>((double)size.y * scale.y, INT32_MAX);
+
+    if (w == 0 || h == 0) return;
+
+    int64_t x0 = pos.x;
+    int64_t y0 = pos.y;
+    int64_t x1 = x0 + w - 1;
+    int64_t y1 = y0 + h - 1;
+
+    if (x1 < pScreenRect.x0 || y1 < pScreenRect.y0 || x0 > pScreenRect.x1 || y0 > pScreenRect.y1) return;
+
+    blit_t blit;
+    blit.pixels = spr->pBuffer + spos.y * spr->pSize.x + spos.x;
+    blit.pitch  = spr->pSize.x;
+    blit.size   = size;
+    blit.pos    = pos;
+    blit.scale  = scale;
+    blit.tint   = tint;
+    blit.bounds = {(int32_t)std::max<int64_t>(x0, pScreenRect.x0),
+                   (int32_t)std::max<int64_t>(y0, pScreenRect.y0),
+                   (int32_t)std::min<int64_t>(x1, pScreenRect.x1),
+                   (int32_t)std::min<int64_t>(y1, pScreenRect.y1)};
+
+    uint32_t n  = blit.bounds.x1 - blit.bounds.x0 + 1;
+    uint32_t cx = blit.bounds.x0 - blit.pos.x;
+
+    // At unit scale both filters read exactly one texel per pixel. Integral scales wider than the clipped row, which
+    // may not even fit the repeat count, show a single texel and are picked like any other scale
+    if (scale.x == 1.0f && scale.y == 1.0f) {
+      blit.type = blit_t::COPY;
+    } else if (filter == pixel::FilterMode::BILINEAR) {
+      blit.type = blit_t::BILINEAR;
+    } else if (scale.x == 1.0f) {
+      blit.type = blit_t::COPY;
+    } else if (scale.x == std::floor(scale.x) && scale.x <= n) {
+      blit.type = blit_t::REPEAT;
+    } else {
+      blit.type = blit_t::NEAREST;
+    }
+
+    // Pixel centres are mapped back to the source rect, and bilinear sampling is clamped to its edge texels
+    if (blit.type == blit_t::NEAREST) {
+      pBlitColumns.resize(n);
+
+      for (uint32_t i = 0; i < n; i++) {
+        pBlitColumns[i] = std::min<uint32_t>((cx + i + 0.5) / scale.x, size.x - 1);
+      }
+
+    } else if (blit.type == blit_t::BILINEAR) {
+      pBlitColumns.resize(n);
+      pBlitWeights.resize(n);
 
-        while (e1 >= dx1) {
-          e1 -= dx1;
+      for (uint32_t i = 0; i < n; i++) {
+        double u = std::clamp((cx + i + 0.5) / scale.x - 0.5, 0.0, size.x - 1.0);
 
-          if (changed1)
-            t1xp = signx1;
-          else
-            goto next1;
+        pBlitColumns[i] = u;
+        pBlitWeights[i] = std::lround((u - pBlitColumns[i]) * 256.0);
+      }
+
+      // The source rect is narrowed to start at the first column read, so rows only interpolate what they use
+      uint32_t first = pBlitColumns[0];
+
+      for (uint32_t i = 0; i < n; i++) pBlitColumns[i] -= first;
+
+      blit.pixels += first;
+      blit.size.x -= first;
+    }
+
+    if (pTiledRaster) pRasterizeCommands();
+
+    pMarkDirty(blit.bounds);
+
+    auto blit_rows = [&](auto mode) {
+      constexpr pixel::DrawingMode M = decltype(mode)::value;
+
+      uint32_t rows = blit.bounds.y1 - blit.bounds.y0 + 1;
+
+      if ((uint64_t)n * rows < pLargeBlit) return pBlitRows<M>(blit, blit.bounds.y0, blit.bounds.y1);
+
+      pRasterJobs().ParallelFor(
+          (rows + pBlitBand - 1) / pBlitBand,
+          [&](uint32_t band) {
+            int32_t y = blit.bounds.y0 + band * pBlitBand;
+            pBlitRows<M>(blit, y, std::min<int32_t>(y + pBlitBand - 1, blit.bounds.y1));
+          },
+          1);
+    };
+
+    switch (pDrawingMode) {
+      case pixel::DrawingMode::NO_ALPHA:
+        blit_rows(std::integral_constant<pixel::DrawingMode, pixel::DrawingMode::NO_ALPHA>());
+        break;
+      case pixel::DrawingMode::FULL_ALPHA:
+        blit_rows(std::integral_constant<pixel::DrawingMode, pixel::DrawingMode::FULL_ALPHA>());
+        break;
+      case pixel::DrawingMode::MASK:
+        blit_rows(std::integral_constant<pixel::DrawingMode, pixel::DrawingMode::MASK>());
+        break;
+    }
+  }
+
+  // Each destination row is first built as a run of tinted texels, then written with the row kernel of the drawing
+  // mode. Untinted rows at unit horizontal scale are composited straight from the sprite, and consecutive rows reading
+  // the same source rows reuse the run built for the first of them
+  template <pixel::DrawingMode M>
+  void Application::pBlitRows(const blit_t& blit, int32_t y0, int32_t y1) {
+    // One run per thread, as the bands of a large blit are built concurrently
+    static thread_local std::vector<Pixel> row;
+    static thread_local std::vector<Pixel> span;
+
+    uint32_t n    = blit.bounds.x1 - blit.bounds.x0 + 1;
+    uint32_t cx   = blit.bounds.x0 - blit.pos.x;
+    bool     tint = blit.tint != White;
+    int64_t  key  = -1;
+
+    row.resize(n);
+
+    // Bilinear rows first interpolate the two source rows over the columns they read, plus a copy of the last one, so
+    // every column can read the one after it
+    uint32_t count = 0;
+
+    if (blit.type == blit_t::BILINEAR) {
+      count = std::min(pBlitColumns[n - 1] + 2, blit.size.x);
+      span.resize(count + 1);
+    }
+
+    // Kept in locals, as stores to the run could otherwise alias the vectors and force reloading them every pixel
+    Pixel*          out     = row.data();
+    Pixel*          lerped  = span.data();
+    const uint32_t* columns = pBlitColumns.data();
+    const uint16_t* weights = pBlitWeights.data();
+
+    for (int32_t y = y0; y <= y1; y++) {
+      uint32_t     dy  = y - blit.pos.y;
+      const Pixel* src = out;
+
+      if (blit.type == blit_t::BILINEAR) {
+        double   v      = std::clamp((dy + 0.5) / blit.scale.y - 0.5, 0.0, blit.size.y - 1.0);
+        uint32_t sy     = v;
+        uint16_t weight = std::lround((v - sy) * 256.0);
+
+        if (key != (int64_t)sy * 257 + weight) {
+          key = (int64_t)sy * 257 + weight;
+
+          const Pixel* top    = blit.pixels + (size_t)sy * blit.pitch;
+          const Pixel* bottom = blit.pixels + (size_t)std::min(sy + 1, blit.size.y - 1) * blit.pitch;
+
+          Blend::Lerp(top, bottom, lerped, count, weight);
+          lerped[count] = lerped[count - 1];
+
+          Blend::Resample(lerped, out, n, columns, weights);
+
+          if (tint) Blend::Modulate(out, out, n, blit.tint);
         }
 
-        if (changed1)
-          break;
-        else
-          t1x += signx1;
-      }
+      } else {
+        uint32_t     sy     = std::min<uint32_t>((dy + 0.5) / blit.scale.y, blit.size.y - 1);
+        const Pixel* texels = blit.pixels + (size_t)sy * blit.pitch;
 
-    next1:
+        if (blit.type == blit_t::COPY && !tint) {
+          src = texels + cx;
 
-      while (1) {
-        e2 += dy2;
+        } else if (key != sy) {
+          key = sy;
 
-        while (e2 >= dx2) {
-          e2 -= dx2;
+          if (blit.type == blit_t::COPY) {
+            std::memcpy(out, texels + cx, n * sizeof(Pixel));
 
-          if (changed2)
-            t2xp = signx2;
-          else
-            goto next2;
+          } else if (blit.type == blit_t::REPEAT) {
+            // The run of the first texel may be cut short by clipping, the ones after it are whole
+            uint32_t k     = blit.scale.x;
+            uint32_t sx    = cx / k;
+            uint32_t first = std::min(k - cx % k, n);
+
+            std::fill_n(out, first, texels[sx]);
+            Blend::Repeat(texels + sx + 1, out + first, n - first, k);
+
+          } else {
+            for (uint32_t i = 0; i < n; i++) out[i] = texels[columns[i]];
+          }
+
+          if (tint) Blend::Modulate(out, out, n, blit.tint);
         }
+      }
 
-        if (changed2)
-          break;
-        else
-          t2x += signx2;
+      Pixel* dst = pBuffer + (size_t)y * pScreenSize.x + blit.bounds.x0;
+
+      if constexpr (M == pixel::DrawingMode::FULL_ALPHA) {
+        Blend::Buffer(src, dst, n);
+      } else if constexpr (M == pixel::DrawingMode::MASK) {
+        Blend::Mask(src, dst, n);
+      } else {
+        std::memcpy(dst, src, n * sizeof(Pixel));
       }
+    }
+  }
 
-    next2:
+  // void Application::DrawWarpedSprite(uint8_t sprite, std::array<vf2d, 4>& pos, const Pixel& tint = White) {
+  //   //! STUB: Implement function.
+  // }
 
-      if (minx > t1x) minx = t1x;
-      if (minx > t2x) minx = t2x;
-      if (maxx < t1x) maxx = t1x;
-      if (maxx < t2x) maxx = t2x;
+  // void Application::DrawPartialWarpedSprite(uint8_t sprite, std::array<vf2d, 4>& post, const vf2d& spos, const vf2d&
+  // ssize, const Pixel& tint = White) {
+  //   //! STUB: Implement function.
+  // }
+
+  // void Application::DrawRotatedSprite(const vf2d& pos, uint8_t sprite, float alpha, const vf2d& center = vf2d(0.0f,
+  // 0.0f), const vf2d scale = vf2d(1.0f, 1.0f), const Pixel& tint = White) {
+  //   //! STUB: Implement function.
+  // }
 
-      drawline(minx, maxx, y);
+  // void Application::DrawPartialRotatedSprite(const vf2d& pos, uint8_t sprite, float alpha, const vf2d& spos, const
+  // vf2d& ssize, const vf2d& center = vf2d(0.0f, 0.0f), const vf2d scale = vf2d(1.0f, 1.0f), const Pixel& tint = White)
+  // {
+  //   //! STUB: Implement function.
+  // }
 
-      if (!changed1) t1x += signx1;
-      t1x += t1xp;
+  void Application::UpdateViewport() {
+    uint32_t ww   = pScreenSize.x * pScale;
+    uint32_t wh   = pScreenSize.y * pScale;
+    float    wasp = (float)ww / (float)wh;
 
-      if (!changed2) t2x += signx2;
-      t2x += t2xp;
+    pViewSize.x = (uint32_t)pWindowSize.x;
+    pViewSize.y = (uint32_t)((float)pViewSize.x / wasp);
 
-      y += 1;
-      if (y == (int32_t)p2.y) break;
+    if (pViewSize.y > pWindowSize.y) {
+      pViewSize.y = pWindowSize.y;
+      pViewSize.x = (uint32_t)((float)pViewSize.y * wasp);
     }
 
-  next:
+    pViewPos = (pWindowSize - pViewSize) / 2;
+  }
 
-    dx1 = (int)(p3.x - p2.x);
-    if (dx1 < 0) {
-      dx1    = -dx1;
-      signx1 = -1;
-    } else
-      signx1 = 1;
-    dy1 = (int)(p3.y - p2.y);
+  pixel::DrawingMode Application::DrawingMode() const { return pDrawingMode; }
 
-    t1x = p2.x;
+  const vu2d& Application::ScreenSize() const { return pScreenSize; }
+  const vu2d& Application::WindowSize() const { return pWindowSize; }
+  const vu2d& Application::WindowPos() const { return pWindowPos; }
+  const vu2d& Application::MousePos() const { return pMousePos; }
 
-    if (dy1 > dx1) {
-      std::swap(dy1, dx1);
-      changed1 = true;
-    } else
-      changed1 = false;
+  vd2d          Application::MouseWheel() const { return pMouseWheel; }
+  void          Application::ResetMouseWheel() { pMouseWheel = {.0f, .0f}; }
+  const Button& Application::Mouse(pixel::Mouse button) const { return pMouseButtons[(uint8_t)button]; }
 
-    e1 = (int)(dx1 >> 1);
+  const Button& Application::Key(pixel::Key key) const { return pKeyboardKeys[(uint16_t)key]; }
 
-    for (int i = 0; i <= dx1; i++) {
-      t1xp = 0;
-      t2xp = 0;
+  const std::vector<InputEvent>& Application::InputEvents() const { return pInputEvents; }
 
-      if (t1x < t2x) {
-        minx = t1x;
-        maxx = t2x;
-      } else {
-        minx = t2x;
-        maxx = t1x;
-      }
+  void Application::UpdateMouseState(uint32_t button, bool state) {
+    if (button < 8) pPushInput({.type = Input::MOUSE_BUTTON, .code = (uint16_t)button, .state = state});
+  }
 
-      while (i < dx1) {
-        e1 += dy1;
+  void Application::UpdateKeyState(uint32_t key, bool state) {
+    if (key < 512) pPushInput({.type = Input::KEY, .code = (uint16_t)key, .state = state});
+  }
 
-        while (e1 >= dx1) {
-          e1 -= dx1;
-          if (changed1) {
-            t1xp = signx1;
-            break;
-          } else
-            goto next3;
+  void Application::UpdateMousePos(const vd2d& pos) { pPushInput({.type = Input::MOUSE_MOVE, .value = pos}); }
+  void Application::UpdateMouseWheel(const vd2d& offset) { pPushInput({.type = Input::MOUSE_WHEEL, .value = offset}); }
+
+  void Application::UpdateMouseFocus(bool state) { pPushInput({.type = Input::MOUSE_FOCUS, .state = state}); }
+  void Application::UpdateKeyFocus(bool state) { pPushInput({.type = Input::KEY_FOCUS, .state = state}); }
+
+  void Application::UpdateWindowSize(uint32_t x, uint32_t y) {
+    pPushInput({.type = Input::WINDOW_SIZE, .value = vd2d(x, y)});
+  }
+
+  void Application::UpdateWindowPos(int32_t x, int32_t y) {
+    pPushInput({.type = Input::WINDOW_POS, .value = vd2d(x, y)});
+  }
+
+  void Application::pPushInput(const InputEvent& event) {
+    uint32_t head = pInputHead.load(std::memory_order_relaxed);
+
+    if (head - pInputTail.load(std::memory_order_acquire) == pInputCapacity) {
+      pInputDropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    InputEvent& slot = pInputRing[head % pInputCapacity];
+    slot             = event;
+    slot.time        = std::chrono::steady_clock::now();
+
+    pInputHead.store(head + 1, std::memory_order_release);
+  }
+
+  // Only the keys that changed last frame need their pressed and released flags cleared. Window and cursor events
+  // arrive in window coordinates, and are applied here so the viewport is only ever touched by the engine thread
+  void Application::pDrainInput() {
+    for (uint16_t key : pKeysChanged) pKeyboardKeys[key].pressed = pKeyboardKeys[key].released = false;
+    for (Button& button : pMouseButtons) button.pressed = button.released = false;
+
+    pKeysChanged.clear();
+    pInputEvents.clear();
+
+    uint32_t tail = pInputTail.load(std::memory_order_relaxed);
+    uint32_t head = pInputHead.load(std::memory_order_acquire);
+
+    for (; tail != head; tail++) {
+      InputEvent& event = pInputEvents.emplace_back(pInputRing[tail % pInputCapacity]);
+
+      auto toggle = [&](Button& button) {
+        if (event.state && !button.held) {
+          button.pressed = true;
+          button.held    = true;
+
+        } else if (!event.state && button.held) {
+          button.released = true;
+          button.held     = false;
         }
+      };
 
-        if (changed1)
+      switch (event.type) {
+        case Input::KEY:
+          toggle(pKeyboardKeys[event.code]);
+          pKeysChanged.push_back(event.code);
           break;
-        else
-          t1x += signx1;
-        if (i < dx1) i++;
-      }
 
-    next3:
+        case Input::MOUSE_BUTTON:
+          toggle(pMouseButtons[event.code]);
+          break;
 
-      while (t2x != (int32_t)p3.x) {
-        e2 += dy2;
+        case Input::MOUSE_MOVE: {
+          vd2d view = (event.value - pViewPos) / (pWindowSize - (pViewPos * 2)) * pScreenSize;
+          vu2d pos  = view;
 
-        while (e2 >= dx2) {
-          e2 -= dx2;
-          if (changed2)
-            t2xp = signx2;
-          else
-            goto next4;
+          if ((view.x < 0.0) || (view.y < 0.0) || (pos.x > pScreenSize.x) || (pos.y > pScreenSize.y)) {
+            pInputEvents.pop_back();
+            break;
+          }
+
+          pMousePos   = pos;
+          event.value = pos;
+          break;
         }
 
-        if (changed2)
+        case Input::MOUSE_WHEEL:
+          pMouseWheel += event.value;
+          break;
+
+        case Input::MOUSE_FOCUS:
+          pHasMouseFocus = event.state;
+          break;
+
+        case Input::KEY_FOCUS:
+          pHasInputFocus = event.state;
+          break;
+
+        case Input::WINDOW_SIZE:
+          pWindowSize = event.value;
+          UpdateViewport();
+          break;
+
+        case Input::WINDOW_POS:
+          pWindowPos = vi2d(event.value);
           break;
-        else
-          t2x += signx2;
       }
+    }
+
+    pInputTail.store(tail, std::memory_order_release);
+  }
+
+  float    Application::et() const { return pElapsedTime; }
+  float    Application::alpha() const { return pFixedAlpha; }
+  uint32_t Application::fps() const { return pFrameRate; }
+
+  const Pixel* Application::Frame() {
+    if (pTiledRaster) pRasterizeCommands();
+    return pBuffer;
+  }
+
+  FrameStats Application::FrameTimes() const { return pFrameStats(pPhaseCount); }
+  FrameStats Application::FrameTimes(pixel::Phase phase) const { return pFrameStats((uint32_t)phase); }
+
+  const std::vector<SpriteRef>& Application::Decals() const { return pSpritesRecorded; }
 
-    next4:
+  JobSystem& Application::Jobs() const { return JobSystem::Shared(); }
 
-      if (minx > t1x) minx = t1x;
-      if (minx > t2x) minx = t2x;
-      if (maxx < t1x) maxx = t1x;
-      if (maxx < t2x) maxx = t2x;
+  void Application::SetProfilerOverlay(bool enabled) { pProfilerOverlay = enabled; }
 
-      drawline(minx, maxx, y);
+  void Application::SetTargetFps(uint32_t fps) { pTargetFps = fps; }
 
-      if (!changed1) t1x += signx1;
-      t1x += t1xp;
+  // Each fade moves pixels at least one level closer to the buffer colour, and at most 255 * (keep / 256) ^ n away
+  // after n of them, which drops below one level after pFadeFrames
+  void Application::SetPersistence(float persistence) {
+    pFadeKeep   = std::clamp<int32_t>(std::lround(std::clamp(persistence, 0.0f, 1.0f) * 256.0f), 0, 255);
+    pFadeFrames = pFadeKeep ? std::ceil(std::log(1.0 / 255.0) / std::log(pFadeKeep / 256.0)) : 0;
+  }
 
-      if (!changed2) t2x += signx2;
-      t2x += t2xp;
+  // et() reads as the fixed step inside on_fixed_update and as the frame time again afterwards. When the frame falls
+  // too far behind, the steps that do not fit are dropped rather than making the next frames even slower
+  void Application::pFixedUpdate() {
+    float elapsed = pElapsedTime;
 
-      y += 1;
-      if (y > (int32_t)p3.y) return;
+    pFixedAccumulator += elapsed;
+    pElapsedTime       = pFixedTimestep;
+
+    for (uint32_t steps = 0; pFixedAccumulator >= pFixedTimestep && pThreadRunning; steps++) {
+      if (steps == pMaxFixedSteps) {
+        pFixedAccumulator = std::fmod(pFixedAccumulator, pFixedTimestep);
+        break;
+      }
+
+      if (pOnFixedUpdate(*this) != rcode::ok) pThreadRunning = false;
+      pFixedAccumulator -= pFixedTimestep;
     }
-  }
 
-  void Application::DrawSprite(const vu2d& pos, Sprite* spr, const vf2d& scale, const Pixel& tint) {
-    SpriteRef spr_ref;
-    spr_ref.pSprite = spr;
+    pElapsedTime = elapsed;
+    pFixedAlpha  = pFixedAccumulator / pFixedTimestep;
+  }
 
-    vf2d newpos = {(float(pos.x) * pInvScreenSize.x) * 2.0f - 1.0f,
-                   ((float(pos.y) * pInvScreenSize.y) * 2.0f - 1.0f) * -1.0f};
+  // Deadlines advance by whole periods so the rate does not drift, but a frame that misses its deadline restarts the
+  // schedule instead of rushing the following ones
+  void Application::pWaitNextFrame() {
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / pTargetFps));
+    auto now = std::chrono::steady_clock::now();
 
-    vf2d newsize = {newpos.x + (2.0f * float(spr->pSize.x) * pInvScreenSize.x) * scale.x,
-                    newpos.y - (2.0f * float(spr->pSize.y) * pInvScreenSize.y) * scale.y};
+    pNextFrame += period;
 
-    spr_ref.pTint = tint;
+    if (pNextFrame <= now) {
+      pNextFrame = now;
+      return;
+    }
 
-    spr_ref.pPos[0] = {newpos.x, newpos.y};
-    spr_ref.pPos[1] = {newpos.x, newsize.y};
-    spr_ref.pPos[2] = {newsize.x, newsize.y};
-    spr_ref.pPos[3] = {newsize.x, newpos.y};
+    if (pNextFrame - now > pSpinMargin) std::this_thread::sleep_until(pNextFrame - pSpinMargin);
 
-    pSpritesPending.push_back(spr_ref);
+    while (std::chrono::steady_clock::now() < pNextFrame) std::this_thread::yield();
   }
 
-  void Application::DrawPartialSprite(const vu2d&  pos,
-                                      const vu2d&  spos,
-                                      const vu2d&  ssize,
-                                      Sprite*      spr,
-                                      const vf2d&  scale,
-                                      const Pixel& tint) {
-    SpriteRef spr_ref;
-    spr_ref.pSprite = spr;
+  void Application::pMarkPhase(pixel::Phase phase) {
+    auto now = std::chrono::steady_clock::now();
 
-    vf2d newpos = {(float(pos.x) * pInvScreenSize.x) * 2.0f - 1.0f,
-                   ((float(pos.y) * pInvScreenSize.y) * 2.0f - 1.0f) * -1.0f};
+#ifdef PIXEL_TRACE
+    Tracer::Record(pPhaseNames[(uint8_t)phase], pPhaseStart, now);
+#endif
 
-    vf2d newsize = {newpos.x + (2.0f * (float)ssize.x * pInvScreenSize.x) * scale.x,
-                    newpos.y - (2.0f * (float)ssize.y * pInvScreenSize.y) * scale.y};
+    pPhaseTimes[(uint8_t)phase] = std::chrono::duration_cast<std::chrono::microseconds>(now - pPhaseStart).count();
+    pPhaseStart                 = now;
+  }
 
-    spr_ref.pTint = tint;
+  void Application::pPushProfile() {
+#ifdef PIXEL_TRACE
+    Tracer::Record(pPhaseNames[pPhaseCount], pClock2, pPhaseStart);
+#endif
 
-    spr_ref.pPos[0] = {newpos.x, newpos.y};
-    spr_ref.pPos[1] = {newpos.x, newsize.y};
-    spr_ref.pPos[2] = {newsize.x, newsize.y};
-    spr_ref.pPos[3] = {newsize.x, newpos.y};
+    uint64_t         head = pProfileHead.load(std::memory_order_relaxed);
+    frame_profile_t& slot = pProfile[head % pProfileFrames];
 
-    vf2d uvtl = (vf2d)spos / (vf2d)spr->pSize * spr->pUvScale;
-    vf2d uvbr = uvtl + ((vf2d)ssize / (vf2d)spr->pSize * spr->pUvScale);
+    uint32_t total = 0;
 
-    spr_ref.pUv[0] = {uvtl.x, uvtl.y};
-    spr_ref.pUv[1] = {uvtl.x, uvbr.y};
-    spr_ref.pUv[2] = {uvbr.x, uvbr.y};
-    spr_ref.pUv[3] = {uvbr.x, uvtl.y};
+    for (uint32_t i = 0; i < pPhaseCount; i++) {
+      slot[i].store(pPhaseTimes[i], std::memory_order_relaxed);
+      total += pPhaseTimes[i];
+    }
 
-    pSpritesPending.push_back(spr_ref);
+    slot[pPhaseCount].store(total, std::memory_order_relaxed);
+    pProfileHead.store(head + 1, std::memory_order_release);
   }
 
-  // void Application::DrawWarpedSprite(uint8_t sprite, std::array<vf2d, 4>& pos, const Pixel& tint = White) {
-  //   //! STUB: Implement function.
-  // }
+  FrameStats Application::pFrameStats(uint32_t column) const {
+    uint64_t head  = pProfileHead.load(std::memory_order_acquire);
+    uint32_t count = (uint32_t)std::min<uint64_t>(head, pProfileFrames);
 
-  // void Application::DrawPartialWarpedSprite(uint8_t sprite, std::array<vf2d, 4>& post, const vf2d& spos, const vf2d&
-  // ssize, const Pixel& tint = White) {
-  //   //! STUB: Implement function.
-  // }
+    FrameStats stats;
+    stats.frames = count;
 
-  // void Application::DrawRotatedSprite(const vf2d& pos, uint8_t sprite, float alpha, const vf2d& center = vf2d(0.0f,
-  // 0.0f), const vf2d scale = vf2d(1.0f, 1.0f), const Pixel& tint = White) {
-  //   //! STUB: Implement function.
-  // }
+    if (count == 0) return stats;
 
-  // void Application::DrawPartialRotatedSprite(const vf2d& pos, uint8_t sprite, float alpha, const vf2d& spos, const
-  // vf2d& ssize, const vf2d& center = vf2d(0.0f, 0.0f), const vf2d scale = vf2d(1.0f, 1.0f), const Pixel& tint = White)
-  // {
-  //   //! STUB: Implement function.
-  // }
+    std::array<uint32_t, pProfileFrames> samples;
+    for (uint32_t i = 0; i < count; i++) {
+      samples[i] = pProfile[(head - 1 - i) % pProfileFrames][column].load(std::memory_order_relaxed);
+    }
 
-  void Application::UpdateViewport() {
-    uint32_t ww   = pScreenSize.x * pScale;
-    uint32_t wh   = pScreenSize.y * pScale;
-    float    wasp = (float)ww / (float)wh;
+    auto percentile = [&](uint32_t p) {
+      auto nth = samples.begin() + (count - 1) * p / 100;
+      std::nth_element(samples.begin(), nth, samples.begin() + count);
 
-    pViewSize.x = (uint32_t)pWindowSize.x;
-    pViewSize.y = (uint32_t)((float)pViewSize.x / wasp);
+      return (float)*nth / 1000.0f;
+    };
 
-    if (pViewSize.y > pWindowSize.y) {
-      pViewSize.y = pWindowSize.y;
-      pViewSize.x = (uint32_t)((float)pViewSize.y * wasp);
-    }
+    stats.p50 = percentile(50);
+    stats.p95 = percentile(95);
+    stats.p99 = percentile(99);
+    stats.max = percentile(100);
 
-    pViewPos = (pWindowSize - pViewSize) / 2;
+    return stats;
   }
 
-  pixel::DrawingMode Application::DrawingMode() const { return pDrawingMode; }
-
-  const vu2d& Application::ScreenSize() const { return pScreenSize; }
-  const vu2d& Application::WindowSize() const { return pWindowSize; }
-  const vu2d& Application::WindowPos() const { return pWindowPos; }
-  const vu2d& Application::MousePos() const { return pMousePos; }
+  // The overlay is always drawn as decals, so it never touches the layer of the application
+  void Application::pDrawProfilerOverlay() {
+    std::string text = "ms         p50    p95    p99\n";
+    char        line[64];
 
-  vd2d          Application::MouseWheel() const { return pMouseWheel; }
-  void          Application::ResetMouseWheel() { pMouseWheel = {.0f, .0f}; }
-  const Button& Application::Mouse(pixel::Mouse button) const { return pMouseButtons[(uint8_t)button]; }
+    for (uint32_t i = 0; i <= pPhaseCount; i++) {
+      FrameStats stats = pFrameStats(i);
 
-  const Button& Application::Key(pixel::Key key) const { return pKeyboardKeys[(uint8_t)key]; }
+      snprintf(line, sizeof(line), "%-8s %6.2f %6.2f %6.2f\n", pPhaseNames[i], stats.p50, stats.p95, stats.p99);
+      text += line;
+    }
 
-  float    Application::et() const { return pElapsedTime; }
-  uint32_t Application::fps() const { return pFrameRate; }
+    pDrawStringDecal(vu2d(2, 2), text, 8, Yellow);
+  }
 
   namespace {
     template <typename _Call>
@@ -1776,6 +5223,43 @@ namespace pixel {
     glEnable(GL_TEXTURE_2D);
     glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
 
+    int major = 0;
+    int minor = 0;
+
+    // Both strings are null when the context could not be made current, which leaves only the 1.1 paths enabled
+    const char* version  = (const char*)glGetString(GL_VERSION);
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+
+    if (version) sscanf(version, "%d.%d", &major, &minor);
+
+    auto load = [](auto& function, const char* name) {
+      function = reinterpret_cast<std::remove_reference_t<decltype(function)>>(glfwGetProcAddress(name));
+    };
+
+    if (major > 1 || (major == 1 && minor >= 5)) {
+      load(pGl.GenBuffers, "glGenBuffers");
+      load(pGl.DeleteBuffers, "glDeleteBuffers");
+      load(pGl.BindBuffer, "glBindBuffer");
+      load(pGl.BufferData, "glBufferData");
+    }
+
+    if (major > 4 || (major == 4 && minor >= 2)) {
+      load(pGl.TexStorage2D, "glTexStorage2D");
+    }
+
+    // Persistently mapped buffers need 4.4. Software rasterizers copy out of a pixel buffer on the calling thread just
+    // like out of client memory, so staging through one would only add a copy there
+    bool software = renderer && (strstr(renderer, "llvmpipe") || strstr(renderer, "softpipe"));
+
+    if ((major > 4 || (major == 4 && minor >= 4)) && !software) {
+      load(pGl.BufferStorage, "glBufferStorage");
+      load(pGl.MapBufferRange, "glMapBufferRange");
+      load(pGl.UnmapBuffer, "glUnmapBuffer");
+      load(pGl.FenceSync, "glFenceSync");
+      load(pGl.ClientWaitSync, "glClientWaitSync");
+      load(pGl.DeleteSync, "glDeleteSync");
+    }
+
     return pixel::ok;
   }
 
@@ -1802,27 +5286,111 @@ namespace pixel {
     glEnd();
   }
 
-  void Renderer::DrawDecalQuad(const SpriteRef& sprite) {
-    glBegin(GL_QUADS);
+  // Streams every pending decal into one vertex buffer and draws it with one call per run of quads sharing a texture.
+  // A quad joins an earlier run with its texture only if it does not overlap any run it would be moved in front of,
+  // so the blended result is the same as drawing the decals one by one in submission order
+  void Renderer::DrawDecalQuads(const std::vector<SpriteRef>& sprites) {
+    if (sprites.empty()) return;
 
-    glColor4ub(sprite.pTint.v.r, sprite.pTint.v.g, sprite.pTint.v.b, sprite.pTint.v.a);
+    pDecalRuns.clear();
+    pDecalRunOf.resize(sprites.size());
 
-    glTexCoord4f(sprite.pUv[0].x, sprite.pUv[0].y, 0.0f, sprite.pW[0]);
-    glVertex2f(sprite.pPos[0].x, sprite.pPos[0].y);
-    glTexCoord4f(sprite.pUv[1].x, sprite.pUv[1].y, 0.0f, sprite.pW[1]);
-    glVertex2f(sprite.pPos[1].x, sprite.pPos[1].y);
-    glTexCoord4f(sprite.pUv[2].x, sprite.pUv[2].y, 0.0f, sprite.pW[2]);
-    glVertex2f(sprite.pPos[2].x, sprite.pPos[2].y);
-    glTexCoord4f(sprite.pUv[3].x, sprite.pUv[3].y, 0.0f, sprite.pW[3]);
-    glVertex2f(sprite.pPos[3].x, sprite.pPos[3].y);
+    for (uint32_t i = 0; i < sprites.size(); i++) {
+      const SpriteRef& sprite = sprites[i];
 
-    glEnd();
+      vf2d min = sprite.pPos[0];
+      vf2d max = sprite.pPos[0];
+
+      for (uint32_t v = 1; v < 4; v++) {
+        min.x = std::min(min.x, sprite.pPos[v].x);
+        min.y = std::min(min.y, sprite.pPos[v].y);
+        max.x = std::max(max.x, sprite.pPos[v].x);
+        max.y = std::max(max.y, sprite.pPos[v].y);
+      }
+
+      uint32_t texture = sprite.pSprite->pBufferId;
+      uint32_t run     = pDecalRuns.size();
+
+      for (uint32_t r = pDecalRuns.size(); r-- > 0 && pDecalRuns.size() - r <= pDecalLookback;) {
+        const decal_run_t& other = pDecalRuns[r];
+
+        if (other.texture == texture) {
+          run = r;
+          break;
+        }
+
+        if (min.x < other.max.x && other.min.x < max.x && min.y < other.max.y && other.min.y < max.y) break;
+      }
+
+      if (run == pDecalRuns.size()) {
+        pDecalRuns.push_back({texture, 0, 0, min, max});
+      } else {
+        decal_run_t& joined = pDecalRuns[run];
+
+        joined.min = vf2d(std::min(joined.min.x, min.x), std::min(joined.min.y, min.y));
+        joined.max = vf2d(std::max(joined.max.x, max.x), std::max(joined.max.y, max.y));
+      }
+
+      pDecalRuns[run].count++;
+      pDecalRunOf[i] = run;
+    }
+
+    // Lay the runs out back to back, then scatter the quads in order so each run keeps its submission order
+    uint32_t first = 0;
+
+    for (auto& run : pDecalRuns) {
+      run.first = first;
+      first += run.count;
+      run.count = 0;
+    }
+
+    pDecalVertices.resize(sprites.size() * 4);
+
+    for (uint32_t i = 0; i < sprites.size(); i++) {
+      const SpriteRef& sprite = sprites[i];
+      decal_run_t&     run    = pDecalRuns[pDecalRunOf[i]];
+      decal_vertex_t*  quad   = &pDecalVertices[(run.first + run.count++) * 4];
+
+      for (uint32_t v = 0; v < 4; v++) {
+        quad[v] = {{sprite.pPos[v].x, sprite.pPos[v].y},
+                   {sprite.pUv[v].x, sprite.pUv[v].y, 0.0f, sprite.pW[v]},
+                   sprite.pTint};
+      }
+    }
+
+    // Without a buffer object the same arrays are read straight from client memory
+    uintptr_t base = (uintptr_t)pDecalVertices.data();
+
+    if (pGl.BufferData) {
+      if (pDecalBuffer == 0) pGl.GenBuffers(1, &pDecalBuffer);
+
+      pGl.BindBuffer(GL_ARRAY_BUFFER, pDecalBuffer);
+      pGl.BufferData(GL_ARRAY_BUFFER, pDecalVertices.size() * sizeof(decal_vertex_t), (void*)base, GL_STREAM_DRAW);
+
+      base = 0;
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    glVertexPointer(2, GL_FLOAT, sizeof(decal_vertex_t), (void*)(base + offsetof(decal_vertex_t, pos)));
+    glTexCoordPointer(4, GL_FLOAT, sizeof(decal_vertex_t), (void*)(base + offsetof(decal_vertex_t, uv)));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(decal_vertex_t), (void*)(base + offsetof(decal_vertex_t, tint)));
+
+    for (const auto& run : pDecalRuns) {
+      ApplyTexture(run.texture);
+      glDrawArrays(GL_QUADS, run.first * 4, run.count * 4);
+    }
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    if (pGl.BufferData) pGl.BindBuffer(GL_ARRAY_BUFFER, 0);
   }
 
   uint32_t Renderer::CreateTexture(uint32_t width, uint32_t height) {
-    IGNORE(width);
-    IGNORE(height);
-
     uint32_t id = 0;
 
     glGenTextures(1, &id);
@@ -1835,6 +5403,13 @@ namespace pixel {
 
     glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 
+    // Storage is allocated once here, every later update only replaces its contents
+    if (pGl.TexStorage2D) {
+      pGl.TexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    } else {
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+
     return id;
   }
 
@@ -1845,12 +5420,112 @@ namespace pixel {
 
   void Renderer::UpdateTexture(uint32_t id, Sprite* spr) {
     IGNORE(id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, spr->pSize.x, spr->pSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, spr->pBuffer);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, spr->pSize.x, spr->pSize.y, GL_RGBA, GL_UNSIGNED_BYTE, spr->pBuffer);
+  }
+
+  void Renderer::UpdateTexture(uint32_t id, const vu2d& pos, Sprite* spr) {
+    IGNORE(id);
+    vu2d size = spr->pSize;
+    glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, spr->pBuffer);
   }
 
   void Renderer::UpdateTexture(uint32_t id, uint32_t w, uint32_t h, Pixel* buffer) {
     IGNORE(id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+  }
+
+  // Uploads the given (position, size) regions of a buffer as large as the texture. When the context supports it the
+  // regions are staged through a ring of persistently mapped pixel buffer objects, so the driver transfers one frame
+  // while the engine thread already draws the next ones instead of stalling on each upload
+  void Renderer::UpdateTexture(uint32_t                                  id,
+                               const vu2d&                               size,
+                               const std::vector<std::pair<vu2d, vu2d>>& regions,
+                               Pixel*                                    buffer) {
+    IGNORE(id);
+
+    if (regions.empty()) return;
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, size.x);
+
+    if (!pGl.BufferStorage) {
+      for (const auto& [pos, extent] : regions) {
+        Pixel* source = buffer + pos.y * size.x + pos.x;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, extent.x, extent.y, GL_RGBA, GL_UNSIGNED_BYTE, source);
+      }
+
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+      return;
+    }
+
+    size_t bytes = (size_t)size.prod() * sizeof(Pixel);
+
+    if (pPixelBufferSize != bytes) {
+      pDeletePixelBuffers();
+
+      uint32_t flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+      for (auto& staging : pPixelBuffers) {
+        pGl.GenBuffers(1, &staging.id);
+        pGl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.id);
+        pGl.BufferStorage(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, flags);
+        staging.mapping = (Pixel*)pGl.MapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags);
+      }
+
+      pPixelBufferSize = bytes;
+    }
+
+    pPixelBufferIndex       = (pPixelBufferIndex + 1) % pPixelBufferCount;
+    pixel_buffer_t& staging = pPixelBuffers[pPixelBufferIndex];
+
+    // The buffer is only rewritten once the transfer issued from it frames ago has completed
+    if (staging.fence) {
+      pGl.ClientWaitSync(staging.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+      pGl.DeleteSync(staging.fence);
+    }
+
+    pGl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.id);
+
+    for (const auto& [pos, extent] : regions) {
+      size_t offset = pos.y * size.x + pos.x;
+
+      for (uint32_t y = 0; y < extent.y; y++) {
+        std::copy_n(buffer + offset + y * size.x, extent.x, staging.mapping + offset + y * size.x);
+      }
+
+      void* source = (void*)(offset * sizeof(Pixel));
+      glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, extent.x, extent.y, GL_RGBA, GL_UNSIGNED_BYTE, source);
+    }
+
+    staging.fence = pGl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    pGl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  }
+
+  void Renderer::DeleteBuffers() {
+    if (pDecalBuffer != 0) {
+      pGl.DeleteBuffers(1, &pDecalBuffer);
+      pDecalBuffer = 0;
+    }
+
+    pDeletePixelBuffers();
+  }
+
+  void Renderer::pDeletePixelBuffers() {
+    if (pPixelBufferSize == 0) return;
+
+    for (auto& staging : pPixelBuffers) {
+      if (staging.fence) pGl.DeleteSync(staging.fence);
+
+      pGl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.id);
+      pGl.UnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      pGl.DeleteBuffers(1, &staging.id);
+
+      staging = pixel_buffer_t();
+    }
+
+    pGl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    pPixelBufferSize = 0;
   }
 
   void Renderer::ApplyTexture(uint32_t id) { glBindTexture(GL_TEXTURE_2D, id); }
@@ -1882,7 +5557,8 @@ namespace pixel {
 
   rcode FileUtil::LoadImage(Sprite* spr, const std::string& filename) {
     // if (std::filesystem::exists(filename)) return rcode::file_err;
-    if (spr->pBuffer != nullptr) delete[] spr->pBuffer;
+    SpritePool::Free(spr->pBuffer);
+    spr->pBuffer = nullptr;
 
     png_structp png;
     png_infop   info;
@@ -1947,7 +5623,7 @@ namespace pixel {
     }
 
     png_read_image(png, row_pointers);
-    spr->pBuffer = new Pixel[spr->GetSize().x * spr->GetSize().y];
+    spr->pBuffer = SpritePool::Allocate(spr->GetSize().x * spr->GetSize().y);
 
     for (uint32_t y = 0; y < spr->GetSize().y; y++) {
       png_bytep row = row_pointers[y];
@@ -1977,13 +5653,6 @@ namespace pixel {
     return rcode::ok;
   }
 
-  void Platform::ApplicationStartUp() { glfwInit(); }
-
-  void Platform::ApplicationCleanUp() {
-    glfwDestroyWindow(pWindow);
-    glfwTerminate();
-  }
-
   rcode Platform::CreateGraphics(bool fullscreen, bool vsync, const vu2d& viewpos, const vu2d& viewsize) {
     if (App->pRenderer.CreateDevice(pWindow, fullscreen, vsync) == rcode::ok) {
       App->pRenderer.UpdateViewport(viewpos, viewsize);
@@ -1994,82 +5663,172 @@ namespace pixel {
   }
 
   rcode Platform::CreateWindowPane(const vu2d& winpos, vu2d& winsize, bool fullscreen) {
-    pWindow = glfwCreateWindow(winsize.x, winsize.y, "Pixel Engine", NULL, NULL);
-    glfwSetWindowPos(pWindow, winpos.x, winpos.y);
-
-    // This is a bit messy, but it works
-    glfwSetWindowSizeCallback(pWindow, fn<void(GLFWwindow*, int, int)>([&](GLFWwindow* window, int width, int height) {
-                                App->pWindowSize.x = width;
-                                App->pWindowSize.y = height;
-                                App->UpdateViewport();
-                              }));
-
-    glfwSetWindowPosCallback(pWindow, fn<void(GLFWwindow*, int, int)>([&](GLFWwindow* window, int posx, int posy) {
-                               App->pWindowPos.x = posx;
-                               App->pWindowPos.y = posy;
-                             }));
-
-    glfwSetCursorPosCallback(
-        pWindow, fn<void(GLFWwindow*, double, double)>([&](GLFWwindow* window, double posx, double posy) {
-          vu2d pos = (vd2d(posx, posy) - App->pViewPos) / (App->pWindowSize - (App->pViewPos * 2)) * App->pScreenSize;
-
-          if (!((pos.x > App->pScreenSize.x) || (pos.y > App->pScreenSize.y))) {
-            App->pMousePos = pos;
-          }
-        }));
+    PlatformService::Instance().Call([&] {
+      pWindow = glfwCreateWindow(winsize.x, winsize.y, "Pixel Engine", NULL, NULL);
+      if (!pWindow) return;
 
-    glfwSetMouseButtonCallback(
-        pWindow, fn<void(GLFWwindow*, int, int, int)>([&](GLFWwindow* window, int button, int action, int mods) {
-          switch (action) {
-            case GLFW_RELEASE:
-              App->pMouseButtonsNew[button] = false;
-              break;
+      glfwSetWindowUserPointer(pWindow, App);
+      glfwSetWindowPos(pWindow, winpos.x, winpos.y);
 
-            case GLFW_PRESS:
-              App->pMouseButtonsNew[button] = true;
-              break;
+      glfwSetWindowSizeCallback(pWindow, [](GLFWwindow* window, int width, int height) {
+        PIXEL_SCOPE("resize");
 
-            default:
-              break;
-          }
-        }));
+        ((Application*)glfwGetWindowUserPointer(window))->UpdateWindowSize(width, height);
+      });
 
-    glfwSetCursorEnterCallback(
-        pWindow, fn<void(GLFWwindow*, int)>([&](GLFWwindow* window, int entered) { App->pHasMouseFocus = entered; }));
+      glfwSetWindowPosCallback(pWindow, [](GLFWwindow* window, int posx, int posy) {
+        ((Application*)glfwGetWindowUserPointer(window))->UpdateWindowPos(posx, posy);
+      });
 
-    glfwSetKeyCallback(
-        pWindow,
-        fn<void(GLFWwindow*, int, int, int, int)>([&](GLFWwindow* window, int key, int scancode, int action, int mods) {
-          if (key == -1) key = 0;
+      glfwSetCursorPosCallback(pWindow, [](GLFWwindow* window, double posx, double posy) {
+        ((Application*)glfwGetWindowUserPointer(window))->UpdateMousePos(vd2d(posx, posy));
+      });
 
-          switch (action) {
-            case GLFW_RELEASE:
-              App->pKeyboardKeysNew[key] = false;
-              break;
+      glfwSetMouseButtonCallback(pWindow, [](GLFWwindow* window, int button, int action, int mods) {
+        PIXEL_SCOPE("mouse button");
 
-            case GLFW_PRESS:
-              App->pKeyboardKeysNew[key] = true;
-              break;
+        Application* app = (Application*)glfwGetWindowUserPointer(window);
 
-            default:
-              break;
-          }
-        }));
+        switch (action) {
+          case GLFW_RELEASE:
+            app->UpdateMouseState(button, false);
+            break;
 
-    glfwSetScrollCallback(pWindow,
-                          fn<void(GLFWwindow*, double, double)>([&](GLFWwindow* window, double deltax, double deltay) {
-                            App->pMouseWheel += vd2d(deltax, deltay);
-                          }));
+          case GLFW_PRESS:
+            app->UpdateMouseState(button, true);
+            break;
 
-    return rcode::ok;
+          default:
+            break;
+        }
+      });
+
+      glfwSetCursorEnterCallback(pWindow, [](GLFWwindow* window, int entered) {
+        ((Application*)glfwGetWindowUserPointer(window))->UpdateMouseFocus(entered);
+      });
+
+      glfwSetWindowFocusCallback(pWindow, [](GLFWwindow* window, int focused) {
+        ((Application*)glfwGetWindowUserPointer(window))->UpdateKeyFocus(focused);
+      });
+
+      glfwSetKeyCallback(pWindow, [](GLFWwindow* window, int key, int scancode, int action, int mods) {
+        PIXEL_SCOPE("key");
+
+        Application* app = (Application*)glfwGetWindowUserPointer(window);
+
+        if (key == -1) key = 0;
+
+        switch (action) {
+          case GLFW_RELEASE:
+            app->UpdateKeyState(key, false);
+            break;
+
+          case GLFW_PRESS:
+            app->UpdateKeyState(key, true);
+            break;
+
+          default:
+            break;
+        }
+      });
+
+      glfwSetScrollCallback(pWindow, [](GLFWwindow* window, double deltax, double deltay) {
+        ((Application*)glfwGetWindowUserPointer(window))->UpdateMouseWheel(vd2d(deltax, deltay));
+      });
+
+      PlatformService::Instance().pWindows.push_back(pWindow);
+    });
+
+    return pWindow ? rcode::ok : rcode::err;
+  }
+
+  // Called from the engine thread once it is done with the window, so its context is released before glfw destroys it
+  void Platform::DestroyWindowPane() {
+    glfwMakeContextCurrent(nullptr);
+
+    PlatformService::Instance().Call([&] {
+      std::erase(PlatformService::Instance().pWindows, pWindow);
+      glfwDestroyWindow(pWindow);
+    });
+
+    pWindow = nullptr;
+  }
+
+  void Platform::SetWindowTitle(const std::string& s) {
+    PlatformService::Instance().Post([window = pWindow, s] { glfwSetWindowTitle(window, s.c_str()); });
+  }
+
+  // Never destroyed, so windows still open when the process exits do not race static destruction
+  PlatformService& PlatformService::Instance() {
+    static PlatformService* instance = new PlatformService();
+    return *instance;
+  }
+
+  void PlatformService::Call(const std::function<void()>& task) {
+    std::packaged_task<void()> packaged(task);
+    std::future<void>          done = packaged.get_future();
+
+    Post([&packaged] { packaged(); });
+    done.wait();
+  }
+
+  void PlatformService::Post(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(pMutex);
+
+    pTasks.push_back(std::move(task));
+
+    if (pRunning) {
+      glfwPostEmptyEvent();
+      return;
+    }
+
+    // The previous service thread has already decided to stop, so joining it only waits for glfwTerminate
+    if (pThread.joinable()) pThread.join();
+
+    pRunning = true;
+    pThread  = std::thread(&PlatformService::pEventLoop, this);
   }
 
-  void Platform::SetWindowTitle(const std::string& s) { glfwSetWindowTitle(pWindow, s.c_str()); }
+  // Window close requests are handed over once and then cleared, so an on_close that keeps the application open is
+  // not asked again
+  void PlatformService::pEventLoop() {
+    PIXEL_TRACE_THREAD("platform");
 
-  void Platform::StartSystemEventLoop() {
-    while (!App->pHasBeenClosed) {
-      App->pWantsToClose = glfwWindowShouldClose(pWindow);
-      glfwPollEvents();
+    glfwInit();
+
+    std::vector<std::function<void()>> tasks;
+
+    while (true) {
+      {
+        std::lock_guard<std::mutex> lock(pMutex);
+        std::swap(tasks, pTasks);
+      }
+
+      for (auto& task : tasks) task();
+      tasks.clear();
+
+      {
+        std::lock_guard<std::mutex> lock(pMutex);
+
+        if (pTasks.empty() && pWindows.empty()) {
+          pRunning = false;
+          break;
+        }
+      }
+
+      {
+        PIXEL_SCOPE("wait events");
+        glfwWaitEventsTimeout(pEventTimeout);
+      }
+
+      for (GLFWwindow* window : pWindows) {
+        if (glfwWindowShouldClose(window)) {
+          ((Application*)glfwGetWindowUserPointer(window))->pWantsToClose = true;
+          glfwSetWindowShouldClose(window, GLFW_FALSE);
+        }
+      }
     }
+
+    glfwTerminate();
   }
 }
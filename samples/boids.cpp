@@ -30,96 +30,116 @@ struct System {
 
   std::vector<Boid> boids;
 
-  void Update(float et, const vf2d &mouse, bool follow_mouse) {
-    auto clamp_angle = [&](float &angle) {
-      if (angle <= 0)
-        angle += 2 * M_PI;
-      if (angle >= 2 * M_PI)
-        angle -= 2 * M_PI;
-    };
+  // Cells a quarter of the view wide, so a query scans little beyond it
+  SpatialGrid<uint32_t> grid{vf2d(0.f, 0.f), vf2d(1024.f, 1024.f),
+                             view_dis / 4};
+
+  // Steering only reads the positions and velocities of the last step, so
+  // every boid can be steered in parallel, and then moved in parallel
+  void Update(JobSystem &jobs, float et, const vf2d &mouse,
+              bool follow_mouse) {
+    grid.Clear();
+    for (uint32_t i = 0; i < boids.size(); i++)
+      grid.Insert(boids[i].pos, i);
+    grid.Build();
+
+    jobs.ParallelFor(boids.size(),
+                     [&](uint32_t i) { Steer(i, mouse, follow_mouse); });
+    jobs.ParallelFor(boids.size(), [&](uint32_t i) { Move(boids[i], et); });
+  }
+
+  static void ClampAngle(float &angle) {
+    if (angle <= 0)
+      angle += 2 * M_PI;
+    if (angle >= 2 * M_PI)
+      angle -= 2 * M_PI;
+  }
 
-    auto clamp_vector = [](vf2d vector, float max) {
-      if (vector.x > max)
-        vector.x = max;
-      if (vector.y > max)
-        vector.y = max;
+  static vf2d ClampVector(vf2d vector, float max) {
+    if (vector.x > max)
+      vector.x = max;
+    if (vector.y > max)
+      vector.y = max;
+
+    return vector;
+  }
 
-      return vector;
-    };
+  void Steer(uint32_t index, const vf2d &mouse, bool follow_mouse) {
+    Boid &b1 = boids[index];
 
-    for (Boid &b1 : boids) {
-      b1.angle = atanf(b1.vel.y / b1.vel.x);
-      b1.angle += (b1.vel.x < 0) ? M_PI : 0;
+    b1.angle = atanf(b1.vel.y / b1.vel.x);
+    b1.angle += (b1.vel.x < 0) ? M_PI : 0;
 
-      clamp_angle(b1.angle);
+    ClampAngle(b1.angle);
 
-      b1.acc = {0, 0};
-      b1.flock = {0, 0};
-      b1.flock_heading = {0, 0};
-      b1.flockmates = 0;
+    b1.acc = {0, 0};
+    b1.flock = {0, 0};
+    b1.flock_heading = {0, 0};
+    b1.flockmates = 0;
 
-      for (Boid &b2 : boids) {
-        if (&b1 == &b2)
-          continue;
+    // A neighbour is in view when the angle between the heading and the
+    // direction to it is below view_angle, which compares as cosines
+    vf2d heading(cosf(b1.angle), sinf(b1.angle));
+    float min_cos = cosf(view_angle);
 
-        float dm = (b1.pos - b2.pos).mod();
-        vf2d d = b1.pos - b2.pos;
+    grid.QueryRadius(b1.pos, view_dis, [&](const vf2d &pos, uint32_t other) {
+      if (other == index)
+        return;
 
-        if (dm > view_dis)
-          continue;
+      const Boid &b2 = boids[other];
 
-        float a = atanf(d.y / d.x);
-        a += (d.x < 0) ? 2 * M_PI : M_PI;
-        clamp_angle(a);
+      vf2d d = b1.pos - pos;
+      float dm = d.mod();
 
-        float b = b1.angle - a;
-        clamp_angle(b);
+      float c = -(heading.x * d.x + heading.y * d.y) / dm;
 
-        if (!(b > (2 * M_PI - view_angle) || b < view_angle ||
-              dm < local_sense))
-          continue;
+      if (!(c > min_cos || dm < local_sense))
+        return;
 
-        b1.flock += b2.pos;
-        b1.flock_heading += b2.vel;
-        b1.flockmates++;
+      b1.flock += b2.pos;
+      b1.flock_heading += b2.vel;
+      b1.flockmates++;
 
-        float g = (b > M_PI) ? (2 * M_PI - b) : b;
-        g /= view_angle;
+      float g = acosf(std::clamp(c, -1.f, 1.f)) / view_angle;
 
-        b1.acc += (d * boid_avoidance_factor / (dm * (g + .01f)));
-      }
+      b1.acc += (d * boid_avoidance_factor / (dm * (g + .01f)));
+    });
 
+    // A lone boid has no flock to steer towards
+    if (b1.flockmates) {
       b1.flock /= b1.flockmates;
       b1.flock_heading /= b1.flockmates;
 
       vf2d d = b1.flock - b1.pos;
 
-      b1.acc += clamp_vector(d * flock_strenght, max_force);
-      b1.acc += clamp_vector(b1.flock_heading * flock_strenght, max_force);
-      if (follow_mouse)
-        b1.acc += clamp_vector(mouse - b1.pos, max_force);
+      b1.acc += ClampVector(d * flock_strenght, max_force);
+      b1.acc += ClampVector(b1.flock_heading * flock_strenght, max_force);
+    }
+    if (follow_mouse)
+      b1.acc += ClampVector(mouse - b1.pos, max_force);
+  }
 
-      b1.vel += (b1.acc * et);
+  void Move(Boid &b1, float et) const {
+    b1.vel += (b1.acc * et);
 
-      float speed = b1.vel.mod();
-      vf2d vel_norm = b1.vel / speed;
+    float speed = b1.vel.mod();
+    vf2d vel_norm = b1.vel / speed;
 
-      speed = std::clamp(speed, min_speed, max_speed);
-      speed = (speed + (max_speed - min_speed)) / 2;
+    speed = std::clamp(speed, min_speed, max_speed);
+    speed = (speed + (max_speed - min_speed)) / 2;
 
-      b1.vel = vel_norm * speed;
+    b1.vel = vel_norm * speed;
 
-      b1.pos += (b1.vel * et);
+    b1.pos += (b1.vel * et);
 
-      if (b1.pos.x <= .0f)
-        b1.pos.x += 1024.f;
-      if (b1.pos.y <= .0f)
-        b1.pos.y += 1024.f;
-      if (b1.pos.x >= 1024.f)
-        b1.pos.x -= 1024.f;
-      if (b1.pos.y >= 1024.f)
-        b1.pos.y -= 1024.f;
-    }
+    if (b1.pos.x <= .0f)
+      b1.pos.x += 1024.f;
+    if (b1.pos.y <= .0f)
+      b1.pos.y += 1024.f;
+    if (b1.pos.x >= 1024.f)
+      b1.pos.x -= 1024.f;
+    if (b1.pos.y >= 1024.f)
+      b1.pos.y -= 1024.f;
   }
 };
 
@@ -150,9 +170,8 @@ int main() {
   Application app(
       {.size = vu2d(1024, 1024),
        .name = "Boids",
+       .fixed_timestep = 1.0f / 120.0f,
        .on_update = fn([&](Application &app) {
-         sys.Update(run ? app.et() : 0, app.MousePos(), mouse);
-
          for (const Boid &boid : sys.boids) {
            vf2d pos1 = boid.pos + (vf2d(cosf(boid.angle + (0 * M_PI)),
                                         sinf(boid.angle + (0 * M_PI))) *
@@ -171,15 +190,21 @@ int main() {
            app.DrawLine(boid.pos, pos3, Pixel(255, 94, 94));
          }
 
-         run = app.Key(Key::R).pressed ? !run : run;
-         mouse = app.Key(Key::M).pressed ? !mouse : mouse;
+         run = app.Key(Key::KEY_R).pressed ? !run : run;
+         mouse = app.Key(Key::KEY_M).pressed ? !mouse : mouse;
 
          if (!run)
            app.DrawString({10, 10}, "Paused");
          if (mouse && run)
            app.DrawString({10, 10}, "Following mouse", 32);
 
-         return app.Key(Key::ESCAPE).pressed ? pixel::quit : pixel::ok;
+         return app.Key(Key::KEY_ESCAPE).pressed ? pixel::quit : pixel::ok;
+       }),
+       // Stepped at a fixed rate, so the flock moves the same whatever the
+       // frame rate is
+       .on_fixed_update = fn([&](Application &app) {
+         sys.Update(app.Jobs(), run ? app.et() : 0, app.MousePos(), mouse);
+         return pixel::ok;
        })});
 
   global_app = &app;
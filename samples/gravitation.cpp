@@ -9,89 +9,98 @@ struct Particle {
   vf2d  p = {0, 0};
   vf2d  s = {0, 0};
   vf2d  a = {0, 0};
-  vf2d  f = {0, 0};
   float m = 0;
   float d = 0;
+  vf2d  o = {0, 0};
 };
 
 struct System {
   std::vector<Particle> particles;
 
-  void Update(float et) {
-    for (auto& p1 : particles) {
-      for (auto& p2 : particles) {
-        if (&p1 != &p2) {
-          d = p1.p - p2.p;
+  // Forces come from a Barnes-Hut tree rebuilt every step, evaluated in parallel
+  void Update(JobSystem& jobs, float et) {
+    positions.resize(particles.size());
+    masses.resize(particles.size());
 
-          r = sqrt((d.x * d.x) + (d.y * d.y));
-          f = (g * p1.m * p2.m) / (r * r);
-          t = atan(d.y / d.x);
-
-          p1.f += vf2d(cos(t), sin(t)) * f * (p2.p.x >= p1.p.x ? 1 : -1);
-          p2.f += vf2d(cos(t), sin(t)) * f * (p2.p.x >= p1.p.x ? -1 : 1);
-        }
-      }
+    for (uint32_t i = 0; i < particles.size(); i++) {
+      positions[i] = particles[i].p;
+      masses[i]    = particles[i].m;
     }
 
-    for (auto& p : particles) {
-      p.a = p.f / p.m;
+    tree.Build(positions, masses);
+    tree.Accelerations(jobs, g, accelerations);
+
+    jobs.ParallelFor(particles.size(), [&](uint32_t i) {
+      Particle& p = particles[i];
+
+      p.o = p.p;
+      p.a = accelerations[i];
       p.s += (p.a * et * s);
       p.p += (p.s * et * s);
-      p.f = {0, 0};
-    }
+    });
   }
 
   float g = 0, s = 0;
-  float r = 0, f = 0, t = 0;
-  vf2d  d;
+
+  QuadTree           tree {0.7f, 2.0f};
+  std::vector<vf2d>  positions;
+  std::vector<float> masses;
+  std::vector<vf2d>  accelerations;
 };
 
 int main() {
-  System sys {.g = 5, .s = 2};
+  System sys {.g = 10, .s = 2};
+
+  sys.particles.push_back({.p = {250, 250}, .s = {0, 0}, .a = {0, 0}, .m = 10000, .d = 0.005f});
+  sys.particles.push_back({.p = {350, 250}, .s = {0, 30}, .a = {0, 0}, .m = 100, .d = 0.05f});
+  sys.particles.push_back({.p = {150, 250}, .s = {0, -30}, .a = {0, 0}, .m = 100, .d = 0.05f});
+  sys.particles.push_back({.p = {450, 250}, .s = {0, 20}, .a = {0, 0}, .m = 200, .d = 0.05f});
+
+  const uint32_t bodies = sys.particles.size();
 
-  sys.particles.push_back({.p = {250, 250}, .s = {0, 0}, .a = {0, 0}, .f = {0, 0}, .m = 10000, .d = 0.005f});
-  sys.particles.push_back({.p = {350, 250}, .s = {0, 30}, .a = {0, 0}, .f = {0, 0}, .m = 100, .d = 0.05f});
-  sys.particles.push_back({.p = {150, 250}, .s = {0, -30}, .a = {0, 0}, .f = {0, 0}, .m = 100, .d = 0.05f});
-  sys.particles.push_back({.p = {450, 250}, .s = {0, 20}, .a = {0, 0}, .f = {0, 0}, .m = 200, .d = 0.05f});
+  // A disc of light dust on circular orbits around the star, stirred up by the planets
+  srand(1);
 
-  struct Trace {
-    vf2d  p;
-    float t;
-  };
+  for (uint32_t i = 0; i < 2000; i++) {
+    float r = 60.0f + 170.0f * rand() / RAND_MAX;
+    float t = 2.0f * M_PI * rand() / RAND_MAX;
+    float v = sqrt(sys.g * sys.particles[0].m / r);
 
-  std::vector<Trace> traces;
+    vf2d dir(cosf(t), sinf(t));
+
+    sys.particles.push_back({.p = sys.particles[0].p + dir * r, .s = vf2d(-dir.y, dir.x) * v, .m = 0.01f});
+  }
+
+  for (auto& p : sys.particles) p.o = p.p;
 
   bool show_pos = false;
   bool show_vel = false;
   bool show_acc = false;
 
   Application app({
-      .size      = vu2d(512, 512),
-      .name      = "Gravitation",
-      .on_update = fn([&](Application& app) {
-        sys.Update(app.et());
-
-        for (decltype(traces)::iterator i = traces.begin(); i != traces.end(); ++i) {
-          i->t += app.et();
-
-          if (i->t > 2.0f) {
-            traces.erase(i);
-            continue;
-          }
-
-          app.Draw(i->p, Pixel(0, 255, 255, 255 - (uint8_t)(i->t / 2.0f * 255.0f)));
+      .size           = vu2d(512, 512),
+      .name           = "Gravitation",
+      .persistence    = 0.96f,
+      .target_fps     = 120,
+      .fixed_timestep = 1.0f / 240.0f,
+      .on_update      = fn([&](Application& app) {
+        // Trails come from persistence, which fades the last frames out instead of clearing them
+        for (uint32_t i = bodies; i < sys.particles.size(); i++) {
+          const Particle& p = sys.particles[i];
+          app.Draw(p.o + (p.p - p.o) * app.alpha(), Grey);
         }
 
-        for (auto& p : sys.particles) {
-          app.FillCircle(p.p, p.m * p.d, White);
-          app.DrawLine(p.p, p.p + p.s, Red);
-          app.DrawLine(p.p, p.p + p.a, Blue);
+        for (uint32_t i = 0; i < bodies; i++) {
+          const Particle& p   = sys.particles[i];
+          vf2d            pos = p.o + (p.p - p.o) * app.alpha();
 
-          traces.push_back({p.p, 0});
+          app.FillCircle(pos, p.m * p.d, White);
+          app.DrawLine(pos, pos + p.s, Red);
+          app.DrawLine(pos, pos + p.a, Blue);
 
-          if (show_pos) app.DrawString(p.p + 10, to_string(p.p), 8, Grey);
-          if (show_vel) app.DrawString(p.p + 10, to_string(p.s), 8, Grey);
-          if (show_acc) app.DrawString(p.p + 10, to_string(p.a), 8, Grey);
+          if (show_pos) app.DrawString(pos + 10, to_string(p.p), 8, Grey);
+          if (show_vel) app.DrawString(pos + 10, to_string(p.s), 8, Grey);
+          if (show_acc) app.DrawString(pos + 10, to_string(p.a), 8, Grey);
         }
 
         show_pos = app.Key(Key::KEY_P).pressed ? !show_pos : show_pos;
@@ -100,6 +109,10 @@ int main() {
 
         return app.Key(Key::KEY_ESCAPE).pressed ? pixel::quit : pixel::ok;
       }),
+      .on_fixed_update = fn([&](Application& app) {
+        sys.Update(app.Jobs(), app.et());
+        return pixel::ok;
+      }),
   });
 
   app.Launch();
@@ -0,0 +1,45 @@
+#include <pixel/pixel.hpp>
+using namespace pixel;
+
+// A million particles falling and bouncing around the window, integrated and drawn in one pass each per frame
+int main() {
+  const uint32_t count = 1000000;
+  const vf2d     size  = vf2d(1024.0f, 768.0f);
+
+  ParticleSystem particles(count);
+
+  srand(1);
+
+  auto rand_float = [](float min, float max) { return (float)rand() / (float)RAND_MAX * (max - min) + min; };
+
+  for (uint32_t i = 0; i < count; i++) {
+    vf2d  pos = vf2d(rand_float(0.0f, size.x), rand_float(0.0f, size.y / 2));
+    vf2d  vel = vf2d(rand_float(-120.0f, 120.0f), rand_float(-60.0f, 60.0f));
+    float hue = pos.x / size.x;
+
+    particles.Emit(pos, vel, Pixel(255 * hue, 96 + 64 * hue, 255 * (1.0f - hue)));
+  }
+
+  bool gravity = true;
+
+  Application app({
+      .size       = vu2d(size.x, size.y),
+      .name       = "Particles",
+      .mode       = DrawingMode::NO_ALPHA,
+      .target_fps = 60,
+      .on_update  = fn([&](Application& app) {
+        particles.Integrate(app.et(), vf2d(0.0f, gravity ? 98.0f : 0.0f), vf2d(0.0f, 0.0f), size - 1.0f);
+        app.DrawParticles(particles);
+
+        app.DrawString({10, 10}, std::to_string(app.fps()) + " fps, " + ParticleSystem::Kernel(), 8, White);
+
+        gravity = app.Key(Key::KEY_G).pressed ? !gravity : gravity;
+
+        return app.Key(Key::KEY_ESCAPE).pressed ? pixel::quit : pixel::ok;
+      }),
+  });
+
+  app.Launch();
+
+  return 0;
+}
@@ -0,0 +1,259 @@
+// Checks every vector kernel the running CPU supports against its scalar twin, the blend kernels over random spans
+// starting at every offset from a cache line and the particle integrators bit for bit, and Blend::Over against exact
+// rounding for every source, destination and alpha. Build and run it with make test, which fails when any differs
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <pixel/pixel.hpp>
+using namespace pixel;
+
+namespace {
+  const uint32_t trials = 4000;
+
+  std::mt19937 rng(0x5EED);
+
+  // Alpha is often 0 or 255, so the opaque and transparent shortcuts of the kernels are taken as well
+  Pixel random_pixel(std::mt19937& r) {
+    uint32_t n     = r();
+    uint8_t  alpha = n >> 24;
+
+    if ((n & 3) == 0) alpha = 0;
+    if ((n & 3) == 1) alpha = 255;
+
+    return Pixel(n & 0xFF, (n >> 8) & 0xFF, (n >> 16) & 0xFF, alpha);
+  }
+
+  std::vector<Pixel> random_pixels(size_t count) {
+    std::vector<Pixel> pixels(count);
+    for (Pixel& p : pixels) p = random_pixel(rng);
+    return pixels;
+  }
+
+  // Mostly spans of a few vectors, where heads and tails dominate, and some long ones
+  size_t random_count() { return rng() % 8 ? rng() % 80 : rng() % 2000; }
+}
+
+namespace pixel {
+  class KernelTest final {
+   public:
+    static uint32_t Run() {
+      uint32_t failures = pCheckOver();
+
+      std::vector<Blend::kernels_t> blend = Blend::pAvailable();
+      for (size_t k = 1; k < blend.size(); k++) failures += pCheckBlend(blend.front(), blend[k]);
+
+      std::vector<ParticleSystem::kernels_t> particles = ParticleSystem::pAvailable();
+      for (size_t k = 1; k < particles.size(); k++) failures += pCheckParticles(particles.front(), particles[k]);
+
+      return failures;
+    }
+
+   private:
+    // Every channel of every source over every destination, at every alpha, through Over and each Buffer kernel
+    static uint32_t pCheckOver() {
+      std::vector<Blend::kernels_t> kernels = Blend::pAvailable();
+      std::vector<uint32_t>         failures(kernels.size() + 1, 0);
+
+      std::vector<Pixel> src(256 * 256);
+      std::vector<Pixel> dst(256 * 256);
+      std::vector<Pixel> out(256 * 256);
+
+      for (uint32_t a = 0; a < 256; a++) {
+        for (uint32_t s = 0; s < 256; s++) {
+          for (uint32_t d = 0; d < 256; d++) {
+            src[s * 256 + d] = Pixel(s, 255 - s, s ^ 0x5A, a);
+            dst[s * 256 + d] = Pixel(d, d ^ 0xA5, 255 - d, d);
+          }
+        }
+
+        auto exact = [&](size_t i) {
+          auto channel = [&](uint32_t sc, uint32_t dc) { return (2 * (sc * a + dc * (255 - a)) + 255) / 510; };
+
+          return Pixel(channel(src[i].v.r, dst[i].v.r),
+                       channel(src[i].v.g, dst[i].v.g),
+                       channel(src[i].v.b, dst[i].v.b));
+        };
+
+        for (size_t i = 0; i < src.size(); i++) failures[0] += Blend::Over(src[i], dst[i]) != exact(i);
+
+        for (size_t k = 0; k < kernels.size(); k++) {
+          out = dst;
+          kernels[k].buffer(src.data(), out.data(), out.size());
+
+          for (size_t i = 0; i < out.size(); i++) failures[k + 1] += out[i] != exact(i);
+        }
+      }
+
+      pReport("exact", "over", failures[0]);
+      for (size_t k = 0; k < kernels.size(); k++) pReport(kernels[k].name, "over", failures[k + 1]);
+
+      uint32_t total = 0;
+      for (uint32_t f : failures) total += f;
+
+      return total;
+    }
+
+    static uint32_t pCheckBlend(const Blend::kernels_t& scalar, const Blend::kernels_t& vector) {
+      uint32_t failures = 0;
+
+      failures += pCompare(scalar, vector, "fill", [](auto& k, const Pixel*, Pixel* dst, size_t n, auto& r) {
+        k.fill(dst, n, random_pixel(r));
+      });
+
+      failures += pCompare(scalar, vector, "buffer", [](auto& k, const Pixel* src, Pixel* dst, size_t n, auto&) {
+        k.buffer(src, dst, n);
+      });
+
+      for (bool stream : {false, true}) {
+        failures += pCompare(scalar,
+                             vector,
+                             stream ? "clear stream" : "clear",
+                             [=](auto& k, const Pixel*, Pixel* dst, size_t n, auto& r) {
+                               k.clear(dst, n, random_pixel(r), stream);
+                             });
+      }
+
+      failures += pCompare(scalar, vector, "fade", [](auto& k, const Pixel*, Pixel* dst, size_t n, auto& r) {
+        k.fade(dst, n, random_pixel(r), r() & 0xFF);
+      });
+
+      failures += pCompare(scalar, vector, "modulate", [](auto& k, const Pixel* src, Pixel* dst, size_t n, auto& r) {
+        k.modulate(src, dst, n, random_pixel(r));
+      });
+
+      failures += pCompare(scalar, vector, "modulate self", [](auto& k, const Pixel*, Pixel* dst, size_t n, auto& r) {
+        k.modulate(dst, dst, n, random_pixel(r));
+      });
+
+      failures += pCompare(scalar, vector, "mask", [](auto& k, const Pixel* src, Pixel* dst, size_t n, auto&) {
+        k.mask(src, dst, n);
+      });
+
+      failures += pCompare(scalar, vector, "lerp", [](auto& k, const Pixel* src, Pixel* dst, size_t n, auto& r) {
+        k.lerp(src, src + n, dst, n, r() % 257);
+      });
+
+      failures += pCompare(scalar, vector, "resample", [](auto& k, const Pixel* src, Pixel* dst, size_t n, auto& r) {
+        std::vector<uint32_t> columns(n);
+        std::vector<uint16_t> weights(n);
+
+        for (size_t i = 0; i < n; i++) {
+          columns[i] = r() % (2 * n + 7);
+          weights[i] = r() % 257;
+        }
+
+        k.resample(src, dst, n, columns.data(), weights.data());
+      });
+
+      failures += pCompare(scalar, vector, "repeat", [](auto& k, const Pixel* src, Pixel* dst, size_t n, auto& r) {
+        k.repeat(src, dst, n, r() % 7);
+      });
+
+      return failures;
+    }
+
+    // Runs one kernel of both tables on copies of the same random pixels, with the same random arguments, at every
+    // offset from a cache line. The destination extends past the span on both sides, so stray writes are caught too
+    template <typename F>
+    static uint32_t pCompare(const Blend::kernels_t& scalar, const Blend::kernels_t& vector, const char* name, F run) {
+      uint32_t failures = 0;
+
+      for (uint32_t trial = 0; trial < trials; trial++) {
+        size_t   offset = trial % 16;
+        size_t   count  = random_count();
+        uint32_t seed   = rng();
+
+        std::vector<Pixel> src      = random_pixels(offset + 2 * count + 8);
+        std::vector<Pixel> expected = random_pixels(offset + count + 16);
+        std::vector<Pixel> actual   = expected;
+
+        std::mt19937 scalar_rng(seed);
+        std::mt19937 vector_rng(seed);
+
+        run(scalar, src.data() + offset, expected.data() + offset, count, scalar_rng);
+        run(vector, src.data() + offset, actual.data() + offset, count, vector_rng);
+
+        failures += expected != actual;
+      }
+
+      pReport(vector.name, name, failures);
+
+      return failures;
+    }
+
+    // Compared bit for bit, with positions that are NaN, signed zeros, infinite or exactly on the bounds of the box
+    static uint32_t pCheckParticles(const ParticleSystem::kernels_t& scalar, const ParticleSystem::kernels_t& vector) {
+      uint32_t failures = 0;
+
+      for (uint32_t trial = 0; trial < trials; trial++) {
+        size_t count = random_count();
+
+        std::uniform_real_distribution<float> bound(-100.0f, 100.0f);
+        float min_x = std::min(bound(rng), 0.0f);
+        float min_y = std::min(bound(rng), 0.0f);
+        float max_x = rng() % 4 ? std::max(bound(rng), 0.0f) : -0.0f;
+        float max_y = rng() % 4 ? std::max(bound(rng), 0.0f) : -0.0f;
+
+        ParticleSystem::step_t step = {1.0f / (1 + rng() % 120),
+                                       vf2d(bound(rng), bound(rng)),
+                                       vf2d(min_x, min_y),
+                                       vf2d(max_x, max_y)};
+
+        auto coordinate = [&](float min, float max) {
+          const float special[] = {std::numeric_limits<float>::quiet_NaN(),
+                                   std::numeric_limits<float>::infinity(),
+                                   -std::numeric_limits<float>::infinity(),
+                                   0.0f,
+                                   -0.0f,
+                                   min,
+                                   max};
+
+          if (rng() % 4 == 0) return special[rng() % std::size(special)];
+          return std::uniform_real_distribution<float>(min - 50.0f, max + 50.0f)(rng);
+        };
+
+        ParticleSystem expected(count);
+        ParticleSystem actual(count);
+
+        for (size_t i = 0; i < count; i++) {
+          vf2d position(coordinate(min_x, max_x), coordinate(min_y, max_y));
+          vf2d velocity(bound(rng), bound(rng));
+
+          expected.Emit(position, velocity);
+          actual.Emit(position, velocity);
+        }
+
+        scalar.integrate(expected.X(), expected.Y(), expected.VX(), expected.VY(), count, step);
+        vector.integrate(actual.X(), actual.Y(), actual.VX(), actual.VY(), count, step);
+
+        bool same = true;
+
+        for (auto array : {&ParticleSystem::X, &ParticleSystem::Y, &ParticleSystem::VX, &ParticleSystem::VY}) {
+          same = same && !std::memcmp((expected.*array)(), (actual.*array)(), count * sizeof(float));
+        }
+
+        failures += !same;
+      }
+
+      pReport(vector.name, "integrate", failures);
+
+      return failures;
+    }
+
+    static void pReport(const char* kernel, const char* name, uint32_t failures) {
+      if (failures) printf("%-6s %-14s FAILED (%u)\n", kernel, name, failures);
+      else printf("%-6s %-14s ok\n", kernel, name);
+    }
+  };
+}
+
+int main() {
+  printf("blend kernel %s\n", Blend::Kernel());
+
+  return pixel::KernelTest::Run() ? 1 : 0;
+}